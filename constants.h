@@ -167,6 +167,13 @@
 
 #define SFG_MAX_DOORS 32
 
+/**
+  Maximum number of squares whose heights can change (doors, elevators and
+  squeezers) that SFG_SQUARE_GRID keeps a list of to update every frame. With
+  more of them in a level the whole grid is searched for them instead.
+*/
+#define SFG_MAX_GRID_DYNAMIC_SQUARES 256
+
 #define SFG_AMMO_BULLETS 0
 #define SFG_AMMO_ROCKETS 1
 #define SFG_AMMO_PLASMA 2
@@ -213,6 +220,63 @@
 */
 #define SFG_DEFAULT_SETTINGS 0x03
 
+/**
+  Number of ray steps a screen column gets on top of what it needed in the
+  previous frame, with SFG_ADAPTIVE_RAY_BUDGETS.
+*/
+#define SFG_RAY_BUDGET_MARGIN_STEPS 16
+
+/**
+  Same as SFG_RAY_BUDGET_MARGIN_STEPS but for ray hits.
+*/
+#define SFG_RAY_BUDGET_MARGIN_HITS 4
+
+/**
+  Distance in RCL_Units up to which walls are textured with the medium quality
+  preset (see SFG_QUALITY_PRESETS), farther walls get the average color of the
+  texture like those beyond SFG_TEXTURE_DISTANCE do with any preset.
+*/
+#define SFG_QUALITY_MEDIUM_TEXTURE_DISTANCE (6 * 1024)
+
+/**
+  Time in ms after which all ray budgets are reset to the full ray constraints
+  (with SFG_ADAPTIVE_RAY_BUDGETS), so that things that appear behind what the
+  columns needed get noticed.
+*/
+#define SFG_RAY_BUDGET_REFRESH_PERIOD 500
+
+/**
+  Number of frames over which the CPU load is averaged before the dynamic
+  resolution (SFG_DYNAMIC_RESOLUTION) is adjusted.
+*/
+#define SFG_DYNAMIC_RESOLUTION_PERIOD_FRAMES 16
+
+/**
+  Average CPU load (in % of the frame time) above which the dynamic resolution
+  is lowered.
+*/
+#define SFG_DYNAMIC_RESOLUTION_LOAD_HIGH 90
+
+/**
+  Average CPU load (in % of the frame time) below which the dynamic resolution
+  is raised. The gap to SFG_DYNAMIC_RESOLUTION_LOAD_HIGH prevents oscillation.
+*/
+#define SFG_DYNAMIC_RESOLUTION_LOAD_LOW 50
+
+/**
+  Fastest camera turning, in degrees per second, at which interlaced rendering
+  (SFG_INTERLACED_RENDERING) still renders only half of the columns. With
+  faster turning the columns kept from the previous frame would be visibly
+  shifted, so the whole view is rendered.
+*/
+#define SFG_INTERLACED_MAX_TURN_SPEED 120
+
+/**
+  Same as SFG_INTERLACED_MAX_TURN_SPEED but for camera movement, in squares per
+  second (this also catches teleports).
+*/
+#define SFG_INTERLACED_MAX_MOVE_SPEED 10
+
 // -----------------------------------------------------------------------------
 // derived constants
 
@@ -237,6 +301,14 @@
   #define SFG_KEY_REPEAT_DELAY_FRAMES 1
 #endif
 
+#define SFG_RAY_BUDGET_REFRESH_FRAMES \
+  (SFG_RAY_BUDGET_REFRESH_PERIOD / SFG_MS_PER_FRAME)
+
+#if SFG_RAY_BUDGET_REFRESH_FRAMES == 0
+  #undef SFG_RAY_BUDGET_REFRESH_FRAMES
+  #define SFG_RAY_BUDGET_REFRESH_FRAMES 1
+#endif
+
 #define SFG_KEY_REPEAT_PERIOD_FRAMES \
   (SFG_KEY_REPEAT_PERIOD / SFG_MS_PER_FRAME)
 
@@ -286,6 +358,12 @@
   #define SFG_PLAYER_MOVE_UNITS_PER_FRAME 1
 #endif
 
+#define SFG_INTERLACED_MAX_TURN_UNITS_PER_FRAME \
+  ((SFG_INTERLACED_MAX_TURN_SPEED * RCL_UNITS_PER_SQUARE) / (360 * SFG_FPS))
+
+#define SFG_INTERLACED_MAX_MOVE_UNITS_PER_FRAME \
+  ((SFG_INTERLACED_MAX_MOVE_SPEED * RCL_UNITS_PER_SQUARE) / SFG_FPS)
+
 #define SFG_GRAVITY_SPEED_INCREASE_PER_FRAME \
   ((SFG_GRAVITY_ACCELERATION * RCL_UNITS_PER_SQUARE) / (SFG_FPS * SFG_FPS))
 
@@ -354,6 +432,53 @@
 
 #define SFG_Z_BUFFER_SIZE SFG_GAME_RESOLUTION_X
 
+/**
+  Number of shadow values in the shade table (SFG_SHADE_TABLES), higher shadow
+  values use the last one. Subtracting 8 or more from a palette color always
+  gives black, so 9 levels are enough.
+*/
+#define SFG_SHADE_LEVELS 9
+
+/**
+  Number of MIP map levels of wall textures (SFG_MIPMAPS), including the full
+  texture, i.e. sizes 32, 16, 8, 4, 2 and 1.
+*/
+#define SFG_MIPMAP_LEVELS 6
+
+/**
+  Size in bytes of the MIP maps of one wall texture, without the full texture.
+*/
+#define SFG_MIPMAP_SIZE ((SFG_TEXTURE_SIZE * SFG_TEXTURE_SIZE - 1) / 3)
+
+/**
+  Says whether a copy of the rendered 3D view is kept (SFG_viewCache).
+*/
+#define SFG_KEEP_VIEW (SFG_REUSE_STATIC_FRAMES || SFG_INTERLACED_RENDERING)
+
+/**
+  Maximum number of moving squares (elevators and squeezers) in the kept 3D
+  view whose heights are checked for SFG_REUSE_STATIC_FRAMES, a view with more
+  of them is never reused.
+*/
+#define SFG_MAX_VIEW_MOVING_SQUARES 32
+
+#if SFG_POST_PROCESS && SFG_UPSCALE == 0
+  // post-processing works on the game resolution buffer
+  #undef SFG_UPSCALE
+  #define SFG_UPSCALE 1
+#endif
+
+#if SFG_UPSCALE != 0 && SFG_RESOLUTION_SCALEDOWN == 1 && !SFG_POST_PROCESS
+  #undef SFG_UPSCALE
+  #define SFG_UPSCALE 0
+#endif
+
+#if SFG_PRESCALED_BACKGROUND && SFG_BACKGROUND_BLUR != 0
+  // blur samples the background at varying offsets, can't be prescaled
+  #undef SFG_PRESCALED_BACKGROUND
+  #define SFG_PRESCALED_BACKGROUND 0
+#endif
+
 /**
   Step in which walls get higher, in raycastlib units.
 */
@@ -377,6 +502,11 @@
 
 #define SFG_MAX_ITEMS SFG_MAX_LEVEL_ELEMENTS
 
+#define SFG_MAX_SPRITES \
+  (SFG_MAX_MONSTERS + SFG_MAX_ITEMS + SFG_MAX_PROJECTILES)
+
+#define SFG_SPRITE_COVER_WORDS ((SFG_GAME_RESOLUTION_Y + 31) / 32)
+
 #define SFG_MAX_SPRITE_SIZE SFG_GAME_RESOLUTION_X
 
 #define SFG_MAP_PIXEL_SIZE (SFG_GAME_RESOLUTION_Y / SFG_MAP_SIZE)
@@ -419,6 +549,28 @@
 #define SFG_HUD_BAR_HEIGHT \
   (SFG_FONT_CHARACTER_SIZE * SFG_FONT_SIZE_MEDIUM + SFG_HUD_MARGIN * 2 + 1)
 
+/**
+  Size of the full z-buffer (SFG_FULL_Z_BUFFER), which has one value for each
+  pixel of the 3D view of the player camera.
+*/
+#define SFG_DEPTH_BUFFER_WIDTH \
+  (SFG_GAME_RESOLUTION_X / SFG_RAYCASTING_SUBSAMPLE)
+
+#define SFG_DEPTH_BUFFER_HEIGHT (SFG_GAME_RESOLUTION_Y - SFG_HUD_BAR_HEIGHT)
+
+/**
+  Size of the square tiles of the full z-buffer for which the minimum and
+  maximum values are kept, so that a whole tile can be accepted or rejected
+  with one compare.
+*/
+#define SFG_DEPTH_TILE_SIZE 8
+
+#define SFG_DEPTH_TILES_X \
+  ((SFG_DEPTH_BUFFER_WIDTH + SFG_DEPTH_TILE_SIZE - 1) / SFG_DEPTH_TILE_SIZE)
+
+#define SFG_DEPTH_TILES_Y \
+  ((SFG_DEPTH_BUFFER_HEIGHT + SFG_DEPTH_TILE_SIZE - 1) / SFG_DEPTH_TILE_SIZE)
+
 // -----------------------------------------------------------------------------
 // monsters
 
@@ -112,7 +112,8 @@ void SFG_sleepMs(uint16_t timeMs);
 /**
   Set specified screen pixel. ColorIndex is the index of the game's palette.
   The function doesn't have to (and shouldn't, for the sake of performance)
-  check whether the coordinates are within screen bounds.
+  check whether the coordinates are within screen bounds. With SFG_FRAMEBUFFER
+  the game implements this function itself and the frontend mustn't.
 */
 static inline void SFG_setPixel(uint16_t x, uint16_t y, uint8_t colorIndex);
 
@@ -197,6 +198,38 @@ uint8_t SFG_mainLoopBody(void);
 */
 void SFG_init(void);
 
+/**
+  Sets the buffer the game will draw into, only with SFG_FRAMEBUFFER. Call this
+  before SFG_init. The buffer holds SFG_SCREEN_RESOLUTION_Y rows of pixels in
+  the format given by SFG_FRAMEBUFFER, stride is the distance between the
+  starts of two rows, in pixels.
+*/
+void SFG_setFramebuffer(void *buffer, uint16_t stride);
+
+#define SFG_POST_PROCESS_SCANLINES   0x01 ///< darkens every other line
+#define SFG_POST_PROCESS_MOTION_BLUR 0x02 ///< dithered blur over a few frames
+#define SFG_POST_PROCESS_GRAYSCALE   0x04 ///< removes colors
+
+/**
+  Sets which post-processing passes are applied to the game picture, as an OR
+  of SFG_POST_PROCESS_* flags, only with SFG_POST_PROCESS. Can be called any
+  time after SFG_init, e.g. when the player toggles an effect.
+*/
+void SFG_setPostProcess(uint8_t passes);
+
+#define SFG_QUALITY_LOW    0 ///< flat colored walls, no dithering or background
+#define SFG_QUALITY_MEDIUM 1 ///< near textures and background, no dithering
+#define SFG_QUALITY_HIGH   2 ///< everything that's enabled by settings
+
+#define SFG_QUALITY_PRESET_COUNT 3
+
+/**
+  Sets the quality preset (SFG_QUALITY_*) of the 3D view, only with
+  SFG_QUALITY_PRESETS. Call this any time after SFG_init, e.g. from a command
+  line flag.
+*/
+void SFG_setQuality(uint8_t preset);
+
 #include "settings.h"
 
 #if SFG_AVR
@@ -209,6 +242,12 @@ void SFG_init(void);
   #define SFG_PROGRAM_MEMORY_U8(addr) ((uint8_t) (*(addr)))
 #endif
 
+#define SFG_UNUSED(what) (void)(what); ///< Suppresses unused warnings.
+
+#if SFG_RENDER_THREADS > 1
+  #include <pthread.h>
+#endif
+
 #include "images.h" // don't change the order of these includes
 #include "levels.h"
 #include "texts.h"
@@ -219,6 +258,16 @@ void SFG_init(void);
 #endif
 
 #define RCL_PIXEL_FUNCTION SFG_pixelFunc
+
+#if SFG_QUALITY_PRESETS && !SFG_SPAN_RENDERING
+  // the preset is switched per span, per pixel it would be slow
+  #undef SFG_SPAN_RENDERING
+  #define SFG_SPAN_RENDERING 1
+#endif
+
+#if SFG_SPAN_RENDERING
+  #define RCL_SPAN_FUNCTION SFG_spanFunc
+#endif
 #define RCL_TEXTURE_VERTICAL_STRETCH 0
 
 #define RCL_CAMERA_COLL_HEIGHT_BELOW 800
@@ -226,6 +275,8 @@ void SFG_init(void);
 
 #define RCL_HORIZONTAL_FOV SFG_FOV_HORIZONTAL
 #define RCL_VERTICAL_FOV SFG_FOV_VERTICAL
+#define RCL_STREAM_HITS SFG_STREAM_HITS
+#define RCL_SKIP_UNIFORM_BLOCKS SFG_SKIP_UNIFORM_BLOCKS
 
 #include "raycastlib.h" 
 
@@ -359,6 +410,31 @@ struct
                                     sounds at once. */
   RCL_RayConstraints rayConstraints; ///< Ray constraints for rendering.
   RCL_RayConstraints visibilityRayConstraints; ///< Constraints for visibility.
+#if SFG_ADAPTIVE_RAY_BUDGETS || SFG_VIEW_SPRITE_VISIBILITY
+  RCL_ColumnInfo rayColumnInfo[SFG_GAME_RESOLUTION_X]; /**< Per column ray
+                                    budgets, their usage and depths, see
+                                    SFG_ADAPTIVE_RAY_BUDGETS and
+                                    SFG_VIEW_SPRITE_VISIBILITY. */
+#endif
+#if SFG_VIEW_SPRITE_VISIBILITY
+  uint16_t viewColumns; /**< Number of columns whose depths in rayColumnInfo
+                                    belong to the current view, 0 if they
+                                    can't be used. */
+#endif
+#if SFG_ADAPTIVE_RAY_BUDGETS
+  uint32_t rayBudgetRefreshFrame; ///< Frame of the last full budget reset.
+  RCL_Unit rayBudgetDirection; ///< Camera direction of the last budget update.
+  uint16_t rayBudgetOverruns; /**< Number of columns that used up their whole
+                                    ray budget in the last rendered frame. */
+  uint32_t rayBudgetOverrunsTotal; ///< Budget overruns summed over all frames.
+#endif
+#if SFG_DYNAMIC_RESOLUTION
+  uint8_t resolutionScaleX; /**< Current horizontal downscale of the 3D view,
+                                 on top of SFG_RAYCASTING_SUBSAMPLE. */
+  uint8_t resolutionScaleY; ///< Current vertical downscale of the 3D view.
+  uint32_t loadSum;         ///< Sum of measured CPU loads (in %).
+  uint8_t loadFrames;       ///< Number of CPU loads in loadSum.
+#endif
   uint8_t keyStates[SFG_KEY_COUNT]; /**< Pressed states of keys, each value
                                     stores the number of frames for which the
                                     key has been held. */
@@ -366,7 +442,25 @@ struct
   uint8_t textureAverageColors[SFG_WALL_TEXTURE_COUNT]; /**< Contains average
                                     color for each wall texture. */
   int8_t backgroundScaleMap[SFG_GAME_RESOLUTION_Y];
+#if SFG_MIPMAPS
+  uint8_t mipmaps[SFG_WALL_TEXTURE_COUNT][SFG_MIPMAP_SIZE]; /**< MIP maps of
+                                    wall textures, each stores the levels from
+                                    the biggest, column by column. */
+  RCL_Unit mipmapDistances[SFG_MIPMAP_LEVELS - 1]; /**< Depths after which
+                                    each smaller MIP map level is used. */
+#endif
+#if SFG_SHADE_TABLES
+  uint8_t shadeTable[SFG_SHADE_LEVELS][256]; /**< Final colors of the 3D view
+                                    for each shadow and color, see
+                                    SFG_SHADE_TABLES. */
+#endif
   uint16_t backgroundScroll;
+#if SFG_PRESCALED_BACKGROUND
+  const uint8_t *backgroundColumns[SFG_GAME_RESOLUTION_X]; /**< Decoded
+                                    background column for each column of the
+                                    render camera, see
+                                    SFG_PRESCALED_BACKGROUND. */
+#endif
   uint8_t spriteSamplingPoints[SFG_MAX_SPRITE_SIZE]; /**< Helper for
                                                      precomputing sprite
                                                      sampling positions for
@@ -407,6 +501,9 @@ struct
          6  32b little endian total play time, in 10ths of sec
          10 16b little endian total enemies killed from start */
   uint8_t continues;  ///< Whether the game continues or was exited.
+#if SFG_QUALITY_PRESETS
+  uint8_t quality;    ///< Quality preset of the 3D view, SFG_QUALITY_*.
+#endif
 } SFG_game;
 
 #define SFG_SAVE_TOTAL_TIME (SFG_game.save[6] + SFG_game.save[7] * 256 + \
@@ -476,8 +573,98 @@ struct
   uint8_t itemCollisionMap[(SFG_MAP_SIZE * SFG_MAP_SIZE) / 8];
                           /**< Bit array, for each map square says whether there
                                is a colliding item or not. */
+#if SFG_SQUARE_GRID
+  RCL_GridSquare squareGrid[SFG_MAP_SIZE * SFG_MAP_SIZE];
+                          /**< Precomputed map squares for rendering, see
+                               SFG_SQUARE_GRID. */
+  uint16_t gridDynamicSquares[SFG_MAX_GRID_DYNAMIC_SQUARES];
+                          /**< Indices of the squareGrid squares whose heights
+                               can change. */
+  uint16_t gridDynamicSquareCount; /**< Number of squares whose heights can
+                               change, more than SFG_MAX_GRID_DYNAMIC_SQUARES
+                               means gridDynamicSquares is incomplete. */
+#endif
+#if SFG_CACHED_MAP
+  uint8_t mapColors[SFG_MAP_SIZE * SFG_MAP_SIZE];
+                          /**< Colors of squares on the map (without the
+                               player), only valid in the parts given by
+                               mapColorsMask, see SFG_CACHED_MAP. */
+  uint16_t mapColorsMask; /**< Map reveal bits of the parts of mapColors that
+                               have been computed. */
+#endif
 } SFG_currentLevel;
 
+#if SFG_KEEP_VIEW
+/**
+  Copy of the last rendered 3D view (without sprites) along with everything it
+  depends on, see SFG_REUSE_STATIC_FRAMES and SFG_INTERLACED_RENDERING.
+*/
+struct
+{
+  uint8_t valid;      ///< Says whether the whole view matches the state below.
+  uint8_t complete;   ///< Says whether all columns have been rendered.
+  RCL_Camera camera;  ///< Camera (with head bob) the view was rendered with.
+#if SFG_INTERLACED_RENDERING
+  uint8_t interlaceOffset; ///< Which columns (even/odd) were rendered last.
+#endif
+#if SFG_REUSE_STATIC_FRAMES
+  uint8_t doorHeights[SFG_MAX_DOORS];
+  uint8_t movingSquareCount; /**< Number of elevators and squeezers the view
+                                  can show, 255 if there were too many. */
+  uint16_t movingSquares[SFG_MAX_VIEW_MOVING_SQUARES]; ///< y * map size + x
+  RCL_Unit movingHeights[SFG_MAX_VIEW_MOVING_SQUARES]; ///< floor + ceiling
+#endif
+  uint8_t pixels[SFG_GAME_RESOLUTION_X * SFG_GAME_RESOLUTION_Y];
+} SFG_viewCache;
+#endif
+
+#define SFG_DECODED_SPRITE_COUNT ((sizeof(SFG_monsterSprites) + \
+  sizeof(SFG_itemSprites) + sizeof(SFG_effectSprites)) / SFG_TEXTURE_STORE_SIZE)
+
+#if SFG_RLE_SPRITES
+/**
+  Maximum size of one run-length encoded sprite column: the run count, two
+  bytes for each of at most SFG_TEXTURE_SIZE / 2 runs and their texels, of which
+  there is one less than SFG_TEXTURE_SIZE for each run above the first.
+*/
+#define SFG_RLE_COLUMN_MAX_SIZE (SFG_TEXTURE_SIZE + 2 + SFG_TEXTURE_SIZE / 2)
+
+/**
+  Monster, item and effect sprites (in this order) with each column stored as
+  runs of opaque texels, see SFG_RLE_SPRITES. A column is the number of runs
+  followed by the runs from the top, each one being its first row, its length
+  and the colors of its texels.
+*/
+struct
+{
+  uint16_t columns[SFG_DECODED_SPRITE_COUNT][SFG_TEXTURE_SIZE]; /**< Offsets
+                                                 of columns in data. */
+  uint8_t data[SFG_DECODED_SPRITE_COUNT * SFG_TEXTURE_SIZE *
+    SFG_RLE_COLUMN_MAX_SIZE];
+} SFG_rleSprites;
+#endif
+
+#if SFG_DECODED_TEXTURES || SFG_PRESCALED_BACKGROUND
+#define SFG_DECODED_IMAGE_SIZE (SFG_TEXTURE_SIZE * SFG_TEXTURE_SIZE)
+
+/**
+  Images decoded to one byte per texel, stored column by column, see
+  SFG_DECODED_TEXTURES.
+*/
+struct
+{
+#if SFG_DECODED_TEXTURES
+  uint8_t walls[8][SFG_DECODED_IMAGE_SIZE]; /**< Textures of the current
+                                                 level, the last one is the
+                                                 door texture. */
+  uint8_t sprites[SFG_DECODED_SPRITE_COUNT][SFG_DECODED_IMAGE_SIZE]; /**<
+                                                 Monster, item and effect
+                                                 sprites, in this order. */
+#endif
+  uint8_t background[SFG_DECODED_IMAGE_SIZE]; ///< Current level background.
+} SFG_decodedImages;
+#endif
+
 #if SFG_AVR
 /**
   Copy of the current level that is stored in RAM. This is only done on Arduino
@@ -816,7 +1003,73 @@ uint16_t SFG_keyRegisters(uint8_t key)
   return SFG_keyJustPressed(key) || SFG_keyRepeated(key);
 }
 
-#if SFG_RESOLUTION_SCALEDOWN == 1
+#if SFG_FRAMEBUFFER != 0
+#if SFG_FRAMEBUFFER == 1
+  typedef uint8_t SFG_FramebufferPixel;
+#elif SFG_FRAMEBUFFER == 2
+  typedef uint16_t SFG_FramebufferPixel;
+#else
+  typedef uint32_t SFG_FramebufferPixel;
+#endif
+
+SFG_FramebufferPixel *SFG_framebuffer = 0;
+uint16_t SFG_framebufferStride = 0;
+
+#if SFG_FRAMEBUFFER == 3
+uint32_t SFG_paletteXRGB8888[256];
+#endif
+
+void SFG_setFramebuffer(void *buffer, uint16_t stride)
+{
+  SFG_framebuffer = (SFG_FramebufferPixel *) buffer;
+  SFG_framebufferStride = stride;
+
+#if SFG_FRAMEBUFFER == 3
+  for (uint16_t i = 0; i < 256; ++i)
+  {
+    uint32_t r = paletteRGB565[i] >> 11;
+    uint32_t g = (paletteRGB565[i] >> 5) & 0x3f;
+    uint32_t b = paletteRGB565[i] & 0x1f;
+
+    SFG_paletteXRGB8888[i] = (((r << 3) | (r >> 2)) << 16) |
+      (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+  }
+#endif
+}
+
+/**
+  Converts a palette color to the framebuffer pixel format.
+*/
+static inline SFG_FramebufferPixel SFG_framebufferColor(uint8_t colorIndex)
+{
+#if SFG_FRAMEBUFFER == 1
+  return colorIndex;
+#elif SFG_FRAMEBUFFER == 2
+  return paletteRGB565[colorIndex];
+#else
+  return SFG_paletteXRGB8888[colorIndex];
+#endif
+}
+
+static inline void SFG_setPixel(uint16_t x, uint16_t y, uint8_t colorIndex)
+{
+  SFG_framebuffer[y * SFG_framebufferStride + x] =
+    SFG_framebufferColor(colorIndex);
+}
+#endif
+
+#if SFG_UPSCALE != 0
+/**
+  The game picture in game resolution, it's scaled up to the screen after each
+  frame, see SFG_UPSCALE.
+*/
+uint8_t SFG_gameScreen[SFG_GAME_RESOLUTION_X * SFG_GAME_RESOLUTION_Y];
+
+static inline void SFG_setGamePixel(uint16_t x, uint16_t y, uint8_t colorIndex)
+{
+  SFG_gameScreen[y * SFG_GAME_RESOLUTION_X + x] = colorIndex;
+}
+#elif SFG_RESOLUTION_SCALEDOWN == 1
   #define SFG_setGamePixel SFG_setPixel
 #else
 
@@ -826,15 +1079,377 @@ uint16_t SFG_keyRegisters(uint8_t key)
 */
 static inline void SFG_setGamePixel(uint16_t x, uint16_t y, uint8_t colorIndex)
 {
+#if SFG_FRAMEBUFFER != 0
+  SFG_FramebufferPixel color = SFG_framebufferColor(colorIndex);
+
+  SFG_FramebufferPixel *pixel = SFG_framebuffer +
+    (y * SFG_framebufferStride + x) * SFG_RESOLUTION_SCALEDOWN;
+
+  for (uint8_t j = 0; j < SFG_RESOLUTION_SCALEDOWN; ++j)
+  {
+    for (uint8_t i = 0; i < SFG_RESOLUTION_SCALEDOWN; ++i)
+      pixel[i] = color;
+
+    pixel += SFG_framebufferStride;
+  }
+#else
   uint16_t screenY = y * SFG_RESOLUTION_SCALEDOWN;
   uint16_t screenX = x * SFG_RESOLUTION_SCALEDOWN;
 
   for (uint16_t j = screenY; j < screenY + SFG_RESOLUTION_SCALEDOWN; ++j)
     for (uint16_t i = screenX; i < screenX + SFG_RESOLUTION_SCALEDOWN; ++i)
       SFG_setPixel(i,j,colorIndex);
+#endif
+}
+#endif
+
+#if SFG_RENDER_THREADS > 1
+/**
+  Simple pool of worker threads used by SFG_runInParallel(...). Part 0 of each
+  job is always done by the calling thread.
+*/
+struct
+{
+  pthread_t threads[SFG_RENDER_THREADS - 1];
+  uint8_t threadCount;    ///< Number of successfully started worker threads.
+  pthread_mutex_t mutex;
+  pthread_cond_t jobStart;
+  pthread_cond_t jobDone;
+  void (*job)(uint8_t, uint8_t);
+  uint32_t jobNumber;     ///< Incremented with each job, wakes the workers up.
+  uint8_t unfinished;     ///< Number of workers still doing the current job.
+} SFG_threadPool;
+
+void *SFG_workerThread(void *data)
+{
+  uint8_t part = (uintptr_t) data;
+  uint32_t jobNumber = 0;
+
+  pthread_mutex_lock(&SFG_threadPool.mutex);
+
+  while (1)
+  {
+    while (SFG_threadPool.jobNumber == jobNumber)
+      pthread_cond_wait(&SFG_threadPool.jobStart,&SFG_threadPool.mutex);
+
+    jobNumber = SFG_threadPool.jobNumber;
+
+    void (*job)(uint8_t, uint8_t) = SFG_threadPool.job;
+    uint8_t parts = SFG_threadPool.threadCount + 1;
+
+    pthread_mutex_unlock(&SFG_threadPool.mutex);
+
+    job(part,parts);
+
+    pthread_mutex_lock(&SFG_threadPool.mutex);
+
+    SFG_threadPool.unfinished--;
+
+    if (SFG_threadPool.unfinished == 0)
+      pthread_cond_signal(&SFG_threadPool.jobDone);
+  }
+
+  return 0;
+}
+
+void SFG_initThreadPool(void)
+{
+  SFG_threadPool.threadCount = 0;
+  SFG_threadPool.jobNumber = 0;
+  SFG_threadPool.unfinished = 0;
+
+  pthread_mutex_init(&SFG_threadPool.mutex,0);
+  pthread_cond_init(&SFG_threadPool.jobStart,0);
+  pthread_cond_init(&SFG_threadPool.jobDone,0);
+
+  for (uint8_t i = 0; i < SFG_RENDER_THREADS - 1; ++i)
+  {
+    if (pthread_create(SFG_threadPool.threads + i,0,SFG_workerThread,
+      (void *) (uintptr_t) (i + 1)) != 0) // pass the part to render
+    {
+      SFG_LOG("couldn't create all threads, rendering with fewer");
+      break;
+    }
+
+    SFG_threadPool.threadCount++;
+  }
+}
+
+/**
+  Runs given job on all threads of the pool and waits for all of them to
+  finish. The job function gets the number of its part and the total number of
+  parts the work should be split into.
+*/
+void SFG_runInParallel(void (*job)(uint8_t part, uint8_t parts))
+{
+  pthread_mutex_lock(&SFG_threadPool.mutex);
+
+  SFG_threadPool.job = job;
+  SFG_threadPool.unfinished = SFG_threadPool.threadCount;
+  SFG_threadPool.jobNumber++;
+
+  pthread_cond_broadcast(&SFG_threadPool.jobStart);
+  pthread_mutex_unlock(&SFG_threadPool.mutex);
+
+  job(0,SFG_threadPool.threadCount + 1);
+
+  pthread_mutex_lock(&SFG_threadPool.mutex);
+
+  while (SFG_threadPool.unfinished != 0)
+    pthread_cond_wait(&SFG_threadPool.jobDone,&SFG_threadPool.mutex);
+
+  pthread_mutex_unlock(&SFG_threadPool.mutex);
+}
+#endif
+
+#if SFG_UPSCALE != 0
+/**
+  Writes one row of screen pixels, given as palette colors.
+*/
+static inline void SFG_writeScreenRow(uint16_t y, const uint8_t *colors)
+{
+#if SFG_FRAMEBUFFER != 0
+  SFG_FramebufferPixel *pixel = SFG_framebuffer + y * SFG_framebufferStride;
+
+  for (uint16_t x = 0; x < SFG_GAME_RESOLUTION_X * SFG_RESOLUTION_SCALEDOWN;
+    ++x)
+    pixel[x] = SFG_framebufferColor(colors[x]);
+#else
+  for (uint16_t x = 0; x < SFG_GAME_RESOLUTION_X * SFG_RESOLUTION_SCALEDOWN;
+    ++x)
+    SFG_setPixel(x,y,colors[x]);
+#endif
+}
+
+/**
+  Scales up given part of the game screen rows (SFG_gameScreen) to the screen,
+  to be run by SFG_runInParallel.
+*/
+void SFG_upscaleRows(uint8_t part, uint8_t parts)
+{
+  #define S SFG_RESOLUTION_SCALEDOWN
+  #define W SFG_GAME_RESOLUTION_X
+
+  uint8_t rows[S][W * S]; // the screen rows of one game row
+
+  for (uint16_t y = (part * SFG_GAME_RESOLUTION_Y) / parts;
+    y < ((part + 1) * SFG_GAME_RESOLUTION_Y) / parts; ++y)
+  {
+    const uint8_t *row = SFG_gameScreen + y * W;
+
+#if SFG_UPSCALE == 2 && (S == 2 || S == 3)
+    // neighbour rows, edges are repeated
+    const uint8_t *up = y > 0 ? row - W : row;
+    const uint8_t *down = y < SFG_GAME_RESOLUTION_Y - 1 ? row + W : row;
+
+    for (uint16_t x = 0; x < W; ++x)
+    {
+      uint16_t l = x > 0 ? x - 1 : x;
+      uint16_t r = x < W - 1 ? x + 1 : x;
+
+      uint8_t
+        a = up[l],   b = up[x],   c = up[r],
+        d = row[l],  e = row[x],  f = row[r],
+        g = down[l], h = down[x], i = down[r];
+
+  #if S == 2
+      SFG_UNUSED(a) SFG_UNUSED(c) SFG_UNUSED(g) SFG_UNUSED(i)
+
+      uint8_t *p = rows[0] + 2 * x;
+
+      if (b != h && d != f)
+      {
+        p[0] = d == b ? d : e;
+        p[1] = b == f ? f : e;
+        p[W * 2] = d == h ? d : e;
+        p[W * 2 + 1] = h == f ? f : e;
+      }
+      else
+        p[0] = p[1] = p[W * 2] = p[W * 2 + 1] = e;
+  #else
+      uint8_t *p = rows[0] + 3 * x;
+
+      if (b != h && d != f)
+      {
+        p[0] = d == b ? d : e;
+        p[1] = (d == b && e != c) || (b == f && e != a) ? b : e;
+        p[2] = b == f ? f : e;
+        p[W * 3] = (d == b && e != g) || (d == h && e != a) ? d : e;
+        p[W * 3 + 1] = e;
+        p[W * 3 + 2] = (b == f && e != i) || (h == f && e != c) ? f : e;
+        p[W * 6] = d == h ? d : e;
+        p[W * 6 + 1] = (d == h && e != i) || (h == f && e != g) ? h : e;
+        p[W * 6 + 2] = h == f ? f : e;
+      }
+      else
+        p[0] = p[1] = p[2] = p[W * 3] = p[W * 3 + 1] = p[W * 3 + 2] =
+          p[W * 6] = p[W * 6 + 1] = p[W * 6 + 2] = e;
+  #endif
+    }
+
+    for (uint8_t j = 0; j < S; ++j)
+      SFG_writeScreenRow(y * S + j,rows[j]);
+#else
+    uint8_t *p = rows[0];
+
+    for (uint16_t x = 0; x < W; ++x)
+      for (uint8_t i = 0; i < S; ++i)
+      {
+        *p = row[x];
+        p++;
+      }
+
+  #if SFG_FRAMEBUFFER != 0
+    // convert the row once, then just copy it
+    SFG_writeScreenRow(y * S,rows[0]);
+
+    SFG_FramebufferPixel *first = SFG_framebuffer +
+      y * S * SFG_framebufferStride;
+
+    for (uint8_t j = 1; j < S; ++j)
+    {
+      SFG_FramebufferPixel *pixel = first + j * SFG_framebufferStride;
+
+      for (uint16_t x = 0; x < W * S; ++x)
+        pixel[x] = first[x];
+    }
+  #else
+    for (uint8_t j = 0; j < S; ++j)
+      SFG_writeScreenRow(y * S + j,rows[0]);
+  #endif
+#endif
+  }
+
+  #undef S
+  #undef W
+}
+#endif
+
+#if SFG_POST_PROCESS
+/**
+  State of the post-processing pipeline. The color passes (scanlines,
+  grayscale) are merged into color maps whenever the passes change, so any
+  combination of them costs a single table lookup per pixel.
+*/
+struct
+{
+  uint8_t passes;            ///< Enabled SFG_POST_PROCESS_* passes.
+  uint8_t colorMaps[2][256]; ///< For normal rows and for scanline rows.
+  uint8_t blurFrame;         ///< Position in the motion blur cycle.
+  uint8_t blurValid;         ///< Whether blurScreen holds a previous frame.
+  uint8_t blurScreen[SFG_GAME_RESOLUTION_X * SFG_GAME_RESOLUTION_Y]; /**<
+                                What the game screen shows with motion blur. */
+} SFG_postProcess;
+
+void SFG_setPostProcess(uint8_t passes)
+{
+  if ((passes & SFG_POST_PROCESS_MOTION_BLUR) &&
+    !(SFG_postProcess.passes & SFG_POST_PROCESS_MOTION_BLUR))
+    SFG_postProcess.blurValid = 0; // the blur buffer holds an old picture
+
+  SFG_postProcess.passes = passes;
+
+  for (uint16_t i = 0; i < 256; ++i)
+  {
+    // palette colors go in rows of 8 from dark to light, first row is gray
+    uint8_t color = (passes & SFG_POST_PROCESS_GRAYSCALE) ? i % 8 : i;
+
+    SFG_postProcess.colorMaps[0][i] = color;
+    SFG_postProcess.colorMaps[1][i] = color -
+      ((passes & SFG_POST_PROCESS_SCANLINES) && (color % 8 != 0));
+  }
+}
+
+/**
+  Applies the post-processing passes to given part of the game screen rows
+  (SFG_gameScreen), to be run by SFG_runInParallel.
+*/
+void SFG_postProcessRows(uint8_t part, uint8_t parts)
+{
+  #define W SFG_GAME_RESOLUTION_X
+
+  for (uint16_t y = (part * SFG_GAME_RESOLUTION_Y) / parts;
+    y < ((part + 1) * SFG_GAME_RESOLUTION_Y) / parts; ++y)
+  {
+    uint8_t *row = SFG_gameScreen + y * W;
+
+    if (SFG_postProcess.passes & SFG_POST_PROCESS_MOTION_BLUR)
+    {
+      uint8_t *shown = SFG_postProcess.blurScreen + y * W;
+
+      if (SFG_postProcess.blurValid)
+      {
+        // dithered: each frame only every Nth pixel gets the new color
+        for (uint16_t x = (SFG_MOTION_BLUR_FRAMES - y % SFG_MOTION_BLUR_FRAMES +
+          SFG_postProcess.blurFrame) % SFG_MOTION_BLUR_FRAMES; x < W;
+          x += SFG_MOTION_BLUR_FRAMES)
+          shown[x] = row[x];
+
+        for (uint16_t x = 0; x < W; ++x)
+          row[x] = shown[x];
+      }
+      else
+        for (uint16_t x = 0; x < W; ++x)
+          shown[x] = row[x];
+    }
+
+    if (SFG_postProcess.passes &
+      (SFG_POST_PROCESS_SCANLINES | SFG_POST_PROCESS_GRAYSCALE))
+    {
+      const uint8_t *map = SFG_postProcess.colorMaps[
+        ((SFG_RESOLUTION_SCALEDOWN == 1 ? y / 2 : y) % 2)];
+
+      for (uint16_t x = 0; x < W; ++x)
+        row[x] = map[row[x]];
+    }
+  }
+
+  #undef W
+}
+
+/**
+  Runs the post-processing passes on the finished frame.
+*/
+void SFG_postProcessFrame(void)
+{
+  if (SFG_postProcess.passes == 0)
+    return;
+
+#if SFG_RENDER_THREADS > 1
+  SFG_runInParallel(SFG_postProcessRows);
+#else
+  SFG_postProcessRows(0,1);
+#endif
+
+  SFG_postProcess.blurFrame =
+    (SFG_postProcess.blurFrame + 1) % SFG_MOTION_BLUR_FRAMES;
+
+  SFG_postProcess.blurValid =
+    (SFG_postProcess.passes & SFG_POST_PROCESS_MOTION_BLUR) != 0;
 }
 #endif
 
+#if SFG_CACHED_HUD
+/**
+  Font characters converted to rows, each row is a 4 bit mask with the highest
+  bit being the leftmost pixel. Made in SFG_init.
+*/
+uint8_t SFG_glyphRows[sizeof(SFG_font) / sizeof(SFG_font[0])]
+  [SFG_FONT_CHARACTER_SIZE];
+
+/**
+  Cached picture of the HUD bar, it's only drawn again when something it shows
+  changes, otherwise it's just copied to the screen.
+*/
+struct
+{
+  uint8_t pixels[SFG_HUD_BAR_HEIGHT * SFG_GAME_RESOLUTION_X];
+  uint32_t key;      ///< Packed values the picture was drawn with.
+  uint8_t valid;
+  uint8_t composing; ///< If 1, text and rectangles are drawn into pixels.
+} SFG_hudCache;
+#endif
+
 void SFG_recomputePLayerDirection(void)
 {
   SFG_player.camera.direction =
@@ -856,7 +1471,16 @@ void SFG_recomputePLayerDirection(void)
 }
 
 #if SFG_BACKGROUND_BLUR != 0
-uint8_t SFG_backgroundBlurIndex = 0;
+/**
+  Gives the index to SFG_backgroundBlurOffsets for a background pixel at given
+  screen position. It is derived from the position rather than counted per
+  drawn pixel so that the blur doesn't depend on the drawing order (e.g. with
+  SFG_RENDER_THREADS). The index is below 7 as index + 1 is read too.
+*/
+static inline uint8_t SFG_backgroundBlurIndex(int16_t x, int16_t y)
+{
+  return (x + y * 3) % 7;
+}
 
 static const int8_t SFG_backgroundBlurOffsets[8] =
   {
@@ -876,19 +1500,180 @@ static inline uint8_t SFG_fogValueDiminish(RCL_Unit depth)
   return depth / SFG_FOG_DIMINISH_STEP;
 }
 
-static inline uint8_t
-  SFG_getTexelFull(uint8_t textureIndex,RCL_Unit u, RCL_Unit v)
+#if SFG_DECODED_TEXTURES || SFG_PRESCALED_BACKGROUND
+/**
+  Decodes an image (texture or sprite) into an array of one byte per texel.
+*/
+void SFG_decodeImage(const uint8_t *image, uint8_t *decoded)
 {
-  return
-    SFG_getTexel(
-      textureIndex != 255 ?
-        SFG_currentLevel.textures[textureIndex] :
-          (SFG_wallTextures + SFG_currentLevel.levelPointer->doorTextureIndex
-          * SFG_TEXTURE_STORE_SIZE), 
-          u / (RCL_UNITS_PER_SQUARE / SFG_TEXTURE_SIZE), 
-          v / (RCL_UNITS_PER_SQUARE / SFG_TEXTURE_SIZE));
-}
-
+  for (uint8_t x = 0; x < SFG_TEXTURE_SIZE; ++x)
+    for (uint8_t y = 0; y < SFG_TEXTURE_SIZE; ++y)
+    {
+      *decoded = SFG_getTexel(image,x,y);
+      decoded++;
+    }
+}
+#endif
+
+#if SFG_DECODED_TEXTURES || SFG_RLE_SPRITES
+/**
+  Gets the index of a monster, item or effect sprite among all of them, in the
+  order of the decoded sprites.
+*/
+static inline uint16_t SFG_spriteIndex(const uint8_t *sprite)
+{
+  uintptr_t address = (uintptr_t) sprite;
+  uint16_t index;
+
+  if (address >= (uintptr_t) SFG_monsterSprites &&
+    address < (uintptr_t) (SFG_monsterSprites + sizeof(SFG_monsterSprites)))
+    index = (sprite - SFG_monsterSprites) / SFG_TEXTURE_STORE_SIZE;
+  else if (address >= (uintptr_t) SFG_itemSprites &&
+    address < (uintptr_t) (SFG_itemSprites + sizeof(SFG_itemSprites)))
+    index = sizeof(SFG_monsterSprites) / SFG_TEXTURE_STORE_SIZE +
+      (sprite - SFG_itemSprites) / SFG_TEXTURE_STORE_SIZE;
+  else
+    index = (sizeof(SFG_monsterSprites) + sizeof(SFG_itemSprites)) /
+      SFG_TEXTURE_STORE_SIZE + (sprite - SFG_effectSprites) /
+      SFG_TEXTURE_STORE_SIZE;
+
+  return index;
+}
+#endif
+
+#if SFG_DECODED_TEXTURES
+
+/**
+  Same as SFG_getTexel, but for an image decoded by SFG_decodeImage.
+*/
+static inline uint8_t SFG_getDecodedTexel(const uint8_t *image, uint8_t x,
+  uint8_t y)
+{
+  return image[(x % SFG_TEXTURE_SIZE) * SFG_TEXTURE_SIZE +
+    y % SFG_TEXTURE_SIZE];
+}
+
+/**
+  Gets the decoded version of a monster, item or effect sprite.
+*/
+static inline const uint8_t *SFG_decodedSprite(const uint8_t *sprite)
+{
+  return SFG_decodedImages.sprites[SFG_spriteIndex(sprite)];
+}
+#endif
+
+#if SFG_RLE_SPRITES
+/**
+  Run-length encodes a sprite into SFG_rleSprites.data starting at given
+  offset, which is then moved after the encoded data. Offsets of the columns
+  are written to columns.
+*/
+void SFG_encodeSprite(const uint8_t *sprite, uint16_t *columns,
+  uint16_t *offset)
+{
+  for (uint8_t x = 0; x < SFG_TEXTURE_SIZE; ++x)
+  {
+    columns[x] = *offset;
+
+    uint8_t *runCount = SFG_rleSprites.data + *offset;
+    *runCount = 0;
+    (*offset)++;
+
+    uint8_t y = 0;
+
+    while (y < SFG_TEXTURE_SIZE)
+    {
+      if (SFG_getTexel(sprite,x,y) == SFG_TRANSPARENT_COLOR)
+      {
+        y++;
+        continue;
+      }
+
+      uint8_t *run = SFG_rleSprites.data + *offset;
+
+      run[0] = y;
+      run[1] = 0;
+      *offset += 2;
+      (*runCount)++;
+
+      while (y < SFG_TEXTURE_SIZE)
+      {
+        uint8_t color = SFG_getTexel(sprite,x,y);
+
+        if (color == SFG_TRANSPARENT_COLOR)
+          break;
+
+        SFG_rleSprites.data[*offset] = color;
+        (*offset)++;
+        run[1]++;
+        y++;
+      }
+    }
+  }
+}
+#endif
+
+static inline uint8_t
+  SFG_getTexelFull(uint8_t textureIndex,RCL_Unit u, RCL_Unit v)
+{
+#if SFG_DECODED_TEXTURES
+  return
+    SFG_getDecodedTexel(
+      SFG_decodedImages.walls[textureIndex != 255 ? textureIndex : 7],
+      u / (RCL_UNITS_PER_SQUARE / SFG_TEXTURE_SIZE), 
+      v / (RCL_UNITS_PER_SQUARE / SFG_TEXTURE_SIZE));
+#else
+  return
+    SFG_getTexel(
+      textureIndex != 255 ?
+        SFG_currentLevel.textures[textureIndex] :
+          (SFG_wallTextures + SFG_currentLevel.levelPointer->doorTextureIndex
+          * SFG_TEXTURE_STORE_SIZE), 
+          u / (RCL_UNITS_PER_SQUARE / SFG_TEXTURE_SIZE), 
+          v / (RCL_UNITS_PER_SQUARE / SFG_TEXTURE_SIZE));
+#endif
+}
+
+#if SFG_MIPMAPS
+/**
+  Gets the MIP map level to draw a wall at given depth with.
+*/
+static inline uint8_t SFG_mipmapLevel(RCL_Unit depth)
+{
+  uint8_t level = 0;
+
+  while (level < SFG_MIPMAP_LEVELS - 1 &&
+    depth > SFG_game.mipmapDistances[level])
+    level++;
+
+  return level;
+}
+
+/**
+  Same as SFG_getTexelFull but samples given MIP map level of the texture.
+*/
+static inline uint8_t SFG_getTexelMipmap(uint8_t textureIndex, uint8_t level,
+  RCL_Unit u, RCL_Unit v)
+{
+  if (level == 0)
+    return SFG_getTexelFull(textureIndex,u,v);
+
+  const uint8_t *mipmap = SFG_game.mipmaps[textureIndex != 255 ?
+    SFG_currentLevel.levelPointer->textureIndices[textureIndex] :
+    SFG_currentLevel.levelPointer->doorTextureIndex];
+
+  uint8_t size = SFG_TEXTURE_SIZE >> level;
+
+  // levels get 4 times smaller, so their sizes add up like this
+  mipmap += (SFG_TEXTURE_SIZE * SFG_TEXTURE_SIZE - 4 * size * size) / 3;
+
+  u = (u / (RCL_UNITS_PER_SQUARE / SFG_TEXTURE_SIZE)) & (SFG_TEXTURE_SIZE - 1);
+  v = (v / (RCL_UNITS_PER_SQUARE / SFG_TEXTURE_SIZE)) & (SFG_TEXTURE_SIZE - 1);
+
+  return mipmap[(u >> level) * size + (v >> level)];
+}
+#endif
+
 static inline uint8_t SFG_getTexelAverage(uint8_t textureIndex)
 {
   return
@@ -903,29 +1688,298 @@ static inline uint8_t SFG_getTexelAverage(uint8_t textureIndex)
       );
 }
 
-void SFG_pixelFunc(RCL_PixelInfo *pixel)
+/**
+  Computes the texture index (into SFG_currentLevel.textures, 255 meaning the
+  door texture) of a wall pixel.
+*/
+static inline uint8_t SFG_wallTextureIndex(RCL_PixelInfo *pixel)
+{
+  return
+    pixel->isFloor ?
+    (
+      ((pixel->hit.type & SFG_TILE_PROPERTY_MASK) != SFG_TILE_PROPERTY_DOOR) ?
+      (pixel->hit.type & 0x7)
+      :
+      (
+        (pixel->texCoords.y > RCL_UNITS_PER_SQUARE) ?
+        (pixel->hit.type & 0x7) : 255
+      )
+    ):
+    ((pixel->hit.type & 0x38) >> 3); 
+}
+
+/**
+  Computes how much a world pixel at given depth and screen position should be
+  darkened by fog.
+*/
+static inline uint8_t SFG_fogShadow(RCL_Unit depth, int16_t x, int16_t y)
+{
+#if SFG_DITHERED_SHADOW
+  uint8_t fogShadow = (depth * 8) / SFG_FOG_DIMINISH_STEP;
+
+  uint8_t fogShadowPart = fogShadow & 0x07;
+
+  fogShadow /= 8;
+
+  uint8_t xMod4 = x & 0x03;
+  uint8_t yMod2 = y & 0x01;
+
+  return
+    fogShadow + SFG_ditheringPatterns[fogShadowPart * 8 + yMod2 * 4 + xMod4];
+#else
+  SFG_UNUSED(x)
+  SFG_UNUSED(y)
+
+  return SFG_fogValueDiminish(depth);
+#endif
+}
+
+/**
+  Gets the color of level background at given screen position of the 3D view.
+*/
+static inline uint8_t SFG_backgroundPixel(RCL_PixelInfo *pixel)
+{
+#if SFG_DRAW_LEVEL_BACKGROUND
+#if SFG_DYNAMIC_RESOLUTION
+  // the background is sampled at the player camera view position
+  int16_t x = pixel->position.x * SFG_game.resolutionScaleX;
+  int16_t y = pixel->position.y * SFG_game.resolutionScaleY;
+#else
+  int16_t x = pixel->position.x;
+  int16_t y = pixel->position.y;
+#endif
+
+#if SFG_PRESCALED_BACKGROUND
+  SFG_UNUSED(x)
+
+  // y is within the game resolution, no need for modulo
+  return SFG_game.backgroundColumns[pixel->position.x][
+    SFG_game.backgroundScaleMap[y]];
+#else
+  uint8_t color =
+#if SFG_DECODED_TEXTURES
+    SFG_getDecodedTexel(SFG_decodedImages.background,
+#else
+    SFG_getTexel(SFG_backgroundImages + 
+      SFG_currentLevel.backgroundImage * SFG_TEXTURE_STORE_SIZE,
+#endif
+    SFG_game.backgroundScaleMap[((x 
+  #if SFG_BACKGROUND_BLUR != 0
+      + SFG_backgroundBlurOffsets[
+        SFG_backgroundBlurIndex(pixel->position.x,pixel->position.y)]
+  #endif
+      ) * SFG_RAYCASTING_SUBSAMPLE + SFG_game.backgroundScroll) % SFG_GAME_RESOLUTION_Y], 
+    (SFG_game.backgroundScaleMap[(y                          // ^ TODO: get rid of mod?
+  #if SFG_BACKGROUND_BLUR != 0
+      + SFG_backgroundBlurOffsets[
+        SFG_backgroundBlurIndex(pixel->position.x,pixel->position.y) + 1]
+  #endif
+      ) % SFG_GAME_RESOLUTION_Y])                                               
+    );
+
+  return color;
+#endif
+#else
+  SFG_UNUSED(pixel)
+
+  return 1;
+#endif
+}
+
+/**
+  Gets the camera the 3D view is rendered with, which is the player camera
+  with the resolution lowered by SFG_DYNAMIC_RESOLUTION.
+*/
+static inline RCL_Camera SFG_renderCamera(void)
+{
+  RCL_Camera camera = SFG_player.camera;
+
+#if SFG_DYNAMIC_RESOLUTION
+  camera.resolution.x = (camera.resolution.x + SFG_game.resolutionScaleX - 1)
+    / SFG_game.resolutionScaleX;
+
+  camera.resolution.y = (camera.resolution.y + SFG_game.resolutionScaleY - 1)
+    / SFG_game.resolutionScaleY;
+
+  camera.shear /= SFG_game.resolutionScaleY;
+#endif
+
+  return camera;
+}
+
+/**
+  Writes a final pixel of the 3D view at given position of the player camera
+  view to the screen.
+*/
+static inline void SFG_setViewPixel(int16_t x, int16_t y, uint8_t color)
+{
+#if SFG_RAYCASTING_SUBSAMPLE == 1
+  // the other version will probably get optimized to this, but just in case
+  SFG_setGamePixel(x,y,color);
+
+#if SFG_KEEP_VIEW
+  SFG_viewCache.pixels[y * SFG_GAME_RESOLUTION_X + x] = color;
+#endif
+#else
+  RCL_Unit screenX = x * SFG_RAYCASTING_SUBSAMPLE;
+
+  for (int_fast8_t i = 0; i < SFG_RAYCASTING_SUBSAMPLE; ++i)
+  {
+    SFG_setGamePixel(screenX,y,color);
+
+#if SFG_KEEP_VIEW
+    SFG_viewCache.pixels[y * SFG_GAME_RESOLUTION_X + screenX] = color;
+#endif
+
+    screenX++;
+  }
+#endif
+}
+
+/**
+  Computes the final color of a 3D view pixel, i.e. applies the shadow (fog)
+  and SFG_BRIGHTNESS to given color.
+*/
+static inline uint8_t SFG_computeShadedColor(uint8_t color, uint8_t shadow)
+{
+#if SFG_ENABLE_FOG
+  color = palette_minusValue(color,shadow);
+#else
+  SFG_UNUSED(shadow)
+#endif
+
+#if SFG_BRIGHTNESS > 0
+  color = palette_plusValue(color,SFG_BRIGHTNESS);
+#elif SFG_BRIGHTNESS < 0
+  color = palette_minusValue(color,-1 * SFG_BRIGHTNESS);
+#endif
+
+  return color;
+}
+
+/**
+  Same as SFG_computeShadedColor, but uses the shade table if it's enabled.
+*/
+static inline uint8_t SFG_shadeColor(uint8_t color, uint8_t shadow)
+{
+#if SFG_SHADE_TABLES
+  return SFG_game.shadeTable[RCL_min(shadow,SFG_SHADE_LEVELS - 1)][color];
+#else
+  return SFG_computeShadedColor(color,shadow);
+#endif
+}
+
+/**
+  Writes a final shaded pixel of the 3D view (i.e. at given position of the
+  render camera view) to the screen.
+*/
+static inline void SFG_setWorldPixel(int16_t x, int16_t y, uint8_t color)
+{
+#if SFG_DYNAMIC_RESOLUTION
+  // the pixel covers a block of pixels of the player camera view
+
+  int16_t x2 = RCL_min((x + 1) * SFG_game.resolutionScaleX,
+    SFG_player.camera.resolution.x);
+
+  int16_t y2 = RCL_min((y + 1) * SFG_game.resolutionScaleY,
+    SFG_player.camera.resolution.y);
+
+  for (int16_t j = y * SFG_game.resolutionScaleY; j < y2; ++j)
+    for (int16_t i = x * SFG_game.resolutionScaleX; i < x2; ++i)
+      SFG_setViewPixel(i,j,color);
+#else
+  SFG_setViewPixel(x,y,color);
+#endif
+}
+
+#if SFG_FULL_Z_BUFFER
+/**
+  Full z-buffer of the 3D view with the minimum and maximum value of each of
+  its tiles, see SFG_FULL_Z_BUFFER. It's only written by rendering the view, so
+  it stays valid when the view is reused.
+*/
+struct
+{
+  uint8_t pixels[SFG_DEPTH_BUFFER_WIDTH * SFG_DEPTH_BUFFER_HEIGHT]; /**< Values
+                                    as given by SFG_RCLUnitToZBuffer, 255
+                                    where there's no wall. */
+  uint8_t tileMin[SFG_DEPTH_TILES_X * SFG_DEPTH_TILES_Y];
+  uint8_t tileMax[SFG_DEPTH_TILES_X * SFG_DEPTH_TILES_Y];
+} SFG_depthBuffer;
+
+/**
+  Writes a z-buffer value of a 3D view pixel, at the same position as given
+  to SFG_setWorldPixel.
+*/
+static inline void SFG_setWorldDepth(int16_t x, int16_t y, uint8_t depth)
+{
+#if SFG_DYNAMIC_RESOLUTION
+  int16_t x2 = RCL_min((x + 1) * SFG_game.resolutionScaleX,
+    SFG_player.camera.resolution.x);
+
+  int16_t y2 = RCL_min((y + 1) * SFG_game.resolutionScaleY,
+    SFG_player.camera.resolution.y);
+
+  for (int16_t j = y * SFG_game.resolutionScaleY; j < y2; ++j)
+    for (int16_t i = x * SFG_game.resolutionScaleX; i < x2; ++i)
+      SFG_depthBuffer.pixels[j * SFG_DEPTH_BUFFER_WIDTH + i] = depth;
+#else
+  SFG_depthBuffer.pixels[y * SFG_DEPTH_BUFFER_WIDTH + x] = depth;
+#endif
+}
+#endif
+
+/**
+  Same as SFG_fogShadow, but only dithers with the high quality preset.
+*/
+static inline uint8_t SFG_fogShadowPreset(RCL_Unit depth, int16_t x, int16_t y,
+  uint8_t quality)
+{
+  return quality == SFG_QUALITY_HIGH ?
+    SFG_fogShadow(depth,x,y) : SFG_fogValueDiminish(depth);
+}
+
+/**
+  Says whether a wall at given depth is drawn with the average color of its
+  texture instead of the texture with given quality preset.
+*/
+static inline uint8_t SFG_flatWallPreset(RCL_Unit depth, uint8_t quality)
+{
+  return quality == SFG_QUALITY_LOW || (quality == SFG_QUALITY_MEDIUM &&
+    depth > SFG_QUALITY_MEDIUM_TEXTURE_DISTANCE);
+}
+
+/**
+  Same as SFG_backgroundPixel, but gives a flat color with the low quality
+  preset (the same as with SFG_DRAW_LEVEL_BACKGROUND turned off).
+*/
+static inline uint8_t SFG_backgroundPixelPreset(RCL_PixelInfo *pixel,
+  uint8_t quality)
+{
+  return quality != SFG_QUALITY_LOW ? SFG_backgroundPixel(pixel) : 1;
+}
+
+/**
+  Draws a pixel of the 3D view with given quality preset (SFG_QUALITY_*). This
+  is always called with a constant preset so that each preset gets compiled
+  into its own function without the checks.
+*/
+static inline void SFG_pixelFuncPreset(RCL_PixelInfo *pixel, uint8_t quality)
 { 
   uint8_t color;
   uint8_t shadow = 0;
 
+#if SFG_FULL_Z_BUFFER
+  uint8_t zValue = 255;
+#endif
+
   if (pixel->isHorizon && pixel->depth > RCL_UNITS_PER_SQUARE * 16)
   {
     color = SFG_TRANSPARENT_COLOR;
   }
   else if (pixel->isWall)
   {
-    uint8_t textureIndex =
-      pixel->isFloor ?
-      (
-        ((pixel->hit.type & SFG_TILE_PROPERTY_MASK) != SFG_TILE_PROPERTY_DOOR) ?
-        (pixel->hit.type & 0x7)
-        :
-        (
-          (pixel->texCoords.y > RCL_UNITS_PER_SQUARE) ?
-          (pixel->hit.type & 0x7) : 255
-        )
-      ):
-      ((pixel->hit.type & 0x38) >> 3); 
+    uint8_t textureIndex = SFG_wallTextureIndex(pixel);
 
 #if SFG_TEXTURE_DISTANCE != 0
     RCL_Unit textureV = pixel->texCoords.y;
@@ -938,7 +1992,12 @@ void SFG_pixelFunc(RCL_PixelInfo *pixel)
     color =
       textureIndex != SFG_TILE_TEXTURE_TRANSPARENT ?
       (
-#if SFG_TEXTURE_DISTANCE >= 65535
+      SFG_flatWallPreset(pixel->depth,quality) ?
+        SFG_getTexelAverage(textureIndex) :
+#if SFG_MIPMAPS && SFG_TEXTURE_DISTANCE != 0
+      SFG_getTexelMipmap(textureIndex,SFG_mipmapLevel(pixel->depth),
+        pixel->texCoords.x,textureV)
+#elif SFG_TEXTURE_DISTANCE >= 65535
       SFG_getTexelFull(textureIndex,pixel->texCoords.x,textureV)
 #elif SFG_TEXTURE_DISTANCE == 0 
       SFG_getTexelAverage(textureIndex)
@@ -976,71 +2035,256 @@ void SFG_pixelFunc(RCL_PixelInfo *pixel)
 
   if (color != SFG_TRANSPARENT_COLOR)
   {
-#if SFG_DITHERED_SHADOW
-    uint8_t fogShadow = (pixel->depth * 8) / SFG_FOG_DIMINISH_STEP;
-
-    uint8_t fogShadowPart = fogShadow & 0x07;
+    shadow += SFG_fogShadowPreset(pixel->depth,pixel->position.x,
+      pixel->position.y,quality);
+    color = SFG_shadeColor(color,shadow);
 
-    fogShadow /= 8;
-
-    uint8_t xMod4 = pixel->position.x & 0x03;
-    uint8_t yMod2 = pixel->position.y & 0x01;
-
-    shadow +=
-      fogShadow + SFG_ditheringPatterns[fogShadowPart * 8 + yMod2 * 4 + xMod4];
-#else
-    shadow += SFG_fogValueDiminish(pixel->depth);
-#endif
-
-#if SFG_ENABLE_FOG
-    color = palette_minusValue(color,shadow);
+#if SFG_FULL_Z_BUFFER
+    if (pixel->isWall)
+      zValue = SFG_RCLUnitToZBuffer(pixel->depth);
 #endif
   }
   else
   {
-#if SFG_DRAW_LEVEL_BACKGROUND
-    color = SFG_getTexel(SFG_backgroundImages + 
-        SFG_currentLevel.backgroundImage * SFG_TEXTURE_STORE_SIZE,
-      SFG_game.backgroundScaleMap[((pixel->position.x 
-  #if SFG_BACKGROUND_BLUR != 0
-        + SFG_backgroundBlurOffsets[SFG_backgroundBlurIndex]
-  #endif
-        ) * SFG_RAYCASTING_SUBSAMPLE + SFG_game.backgroundScroll) % SFG_GAME_RESOLUTION_Y], 
-      (SFG_game.backgroundScaleMap[(pixel->position.y          // ^ TODO: get rid of mod?
-  #if SFG_BACKGROUND_BLUR != 0
-        + SFG_backgroundBlurOffsets[SFG_backgroundBlurIndex + 1]
-  #endif
-        ) % SFG_GAME_RESOLUTION_Y])                                               
-      );
-
-  #if SFG_BACKGROUND_BLUR != 0
-      SFG_backgroundBlurIndex = (SFG_backgroundBlurIndex + 1) % 8;
-  #endif
-#else
-    color = 1;
-#endif
+    color = SFG_shadeColor(SFG_backgroundPixelPreset(pixel,quality),0);
   }
 
-#if SFG_BRIGHTNESS > 0
-  color = palette_plusValue(color,SFG_BRIGHTNESS);
-#elif SFG_BRIGHTNESS < 0
-  color = palette_minusValue(color,-1 * SFG_BRIGHTNESS);
+  SFG_setWorldPixel(pixel->position.x,pixel->position.y,color);
+
+#if SFG_FULL_Z_BUFFER
+  SFG_setWorldDepth(pixel->position.x,pixel->position.y,zValue);
 #endif
+}
 
-#if SFG_RAYCASTING_SUBSAMPLE == 1
-  // the other version will probably get optimized to this, but just in case
-  SFG_setGamePixel(pixel->position.x,pixel->position.y,color);
-#else
-  RCL_Unit screenX = pixel->position.x * SFG_RAYCASTING_SUBSAMPLE;
+/* With SFG_QUALITY_PRESETS the view is drawn by spans (SFG_spanFunc) and
+   raycastlib only falls back to this for floor pixels with texture coordinates,
+   which the game never asks for, so this has no variants for the presets. */
+void SFG_pixelFunc(RCL_PixelInfo *pixel)
+{
+  SFG_pixelFuncPreset(pixel,SFG_QUALITY_HIGH);
+}
 
-  for (int_fast8_t i = 0; i < SFG_RAYCASTING_SUBSAMPLE; ++i)
+#if SFG_QUALITY_PRESETS
+void SFG_setQuality(uint8_t preset)
+{
+  SFG_game.quality = RCL_min(preset,SFG_QUALITY_PRESET_COUNT - 1);
+
+#if SFG_KEEP_VIEW
+  // the kept view has been drawn with the previous preset
+  SFG_viewCache.valid = 0;
+  SFG_viewCache.complete = 0;
+#endif
+}
+#endif
+
+#if SFG_SPAN_RENDERING
+/**
+  Span version of SFG_pixelFuncPreset (see RCL_SpanInfo), draws the same pixels
+  but only computes the values which are constant along the span once.
+*/
+static inline void SFG_spanFuncPreset(RCL_PixelInfo *pixel, RCL_SpanInfo *span,
+  uint8_t quality)
+{
+  /* Values changing along the span are kept in local variables and only
+     written to the pixel info when a function needs it, otherwise they'd have
+     to be reloaded after each pixel write (which may alias anything). */
+
+  int16_t x = pixel->position.x;
+  int16_t y = pixel->position.y;
+  int8_t increment = span->increment;
+  int16_t length = span->length;
+
+  if (pixel->isWall)
   {
-    SFG_setGamePixel(screenX,pixel->position.y,color);
-    screenX++;
+    uint8_t shadow = pixel->hit.direction >> 1;
+
+    // the fog is constant along a wall but the dithering alternates in rows
+    uint8_t shadows[2];
+
+    shadows[y & 0x01] = shadow +
+      SFG_fogShadowPreset(pixel->depth,x,y,quality);
+
+    shadows[(y + 1) & 0x01] = shadow +
+      SFG_fogShadowPreset(pixel->depth,x,y + 1,quality);
+
+    uint8_t textureIndex = SFG_wallTextureIndex(pixel);
+    uint8_t flat = SFG_flatWallPreset(pixel->depth,quality);
+
+#if SFG_FULL_Z_BUFFER
+    uint8_t zValue = SFG_RCLUnitToZBuffer(pixel->depth);
+#endif
+
+    // floor walls of doors switch from the door texture at some height
+    uint8_t isDoor = pixel->isFloor &&
+      (pixel->hit.type & SFG_TILE_PROPERTY_MASK) == SFG_TILE_PROPERTY_DOOR;
+
+    RCL_Unit textureU = pixel->texCoords.x;
+    RCL_Unit textureV = pixel->texCoords.y;
+
+    SFG_UNUSED(textureU)
+
+#if SFG_TEXTURE_DISTANCE != 0
+    RCL_Unit textureVOffset =
+      ((pixel->hit.type & SFG_TILE_PROPERTY_MASK) ==
+      SFG_TILE_PROPERTY_SQUEEZER) ? pixel->wallHeight : 0;
+
+  #if SFG_MIPMAPS
+    uint8_t mipmapLevel = SFG_mipmapLevel(pixel->depth);
+  #elif SFG_TEXTURE_DISTANCE < 65535
+    uint8_t textured = pixel->depth <= SFG_TEXTURE_DISTANCE;
+  #endif
+#endif
+
+#if RCL_COMPUTE_WALL_TEXCOORDS == 1
+    RCL_Unit textureCoordScaled = span->texCoordScaled;
+    RCL_Unit textureCoordStep = span->texCoordStepScaled;
+#endif
+
+    for (int16_t i = 0; i < length; ++i)
+    {
+#if RCL_COMPUTE_WALL_TEXCOORDS == 1
+      textureV = textureCoordScaled / RCL_TEXTURE_INTERPOLATION_SCALE;
+
+      textureCoordScaled += textureCoordStep;
+#endif
+
+      if (isDoor)
+      {
+        pixel->texCoords.y = textureV;
+        textureIndex = SFG_wallTextureIndex(pixel);
+      }
+
+      uint8_t color;
+
+      if (textureIndex != SFG_TILE_TEXTURE_TRANSPARENT)
+      {
+        if (flat)
+          color = SFG_getTexelAverage(textureIndex);
+        else
+#if SFG_MIPMAPS && SFG_TEXTURE_DISTANCE != 0
+        color = SFG_getTexelMipmap(textureIndex,mipmapLevel,textureU,
+          textureV + textureVOffset);
+#elif SFG_TEXTURE_DISTANCE >= 65535
+        color = SFG_getTexelFull(textureIndex,textureU,
+          textureV + textureVOffset);
+#elif SFG_TEXTURE_DISTANCE == 0 
+        color = SFG_getTexelAverage(textureIndex);
+#else
+        color = textured ?
+          SFG_getTexelFull(textureIndex,textureU,textureV + textureVOffset) :
+          SFG_getTexelAverage(textureIndex);
+#endif
+      }
+      else
+        color = SFG_TRANSPARENT_COLOR;
+
+      if (color != SFG_TRANSPARENT_COLOR)
+      {
+        color = SFG_shadeColor(color,shadows[y & 0x01]);
+
+#if SFG_FULL_Z_BUFFER
+        SFG_setWorldDepth(x,y,zValue);
+#endif
+      }
+      else
+      {
+        pixel->position.y = y;
+        color = SFG_shadeColor(SFG_backgroundPixelPreset(pixel,quality),0);
+
+#if SFG_FULL_Z_BUFFER
+        SFG_setWorldDepth(x,y,255);
+#endif
+      }
+
+      SFG_setWorldPixel(x,y,color);
+
+      y += increment;
+    }
   }
+  else
+  {
+    uint8_t spanColor = pixel->isFloor ?
+      (
+#if SFG_DIFFERENT_FLOOR_CEILING_COLORS
+        2 + (pixel->height / SFG_WALL_HEIGHT_STEP) % 4
+#else
+        SFG_currentLevel.floorColor
+#endif
+      ) : 
+      (pixel->height < SFG_CEILING_MAX_HEIGHT ?
+        (
+#if SFG_DIFFERENT_FLOOR_CEILING_COLORS
+          18 + (pixel->height / SFG_WALL_HEIGHT_STEP) % 4
+#else
+          SFG_currentLevel.ceilingColor 
+#endif
+        )
+        : SFG_TRANSPARENT_COLOR);
+
+    uint8_t isHorizon = pixel->isHorizon;
+    RCL_Unit depth = span->depth;
+    RCL_Unit depthIncrement = span->depthIncrement;
+
+    for (int16_t i = 0; i < length; ++i)
+    {
+      RCL_Unit pixelDepth = RCL_zeroClamp(depth);
+      depth += depthIncrement;
+
+      uint8_t color =
+        (isHorizon && pixelDepth > RCL_UNITS_PER_SQUARE * 16) ?
+        SFG_TRANSPARENT_COLOR : spanColor;
+
+      if (color != SFG_TRANSPARENT_COLOR)
+        color = SFG_shadeColor(color,
+          SFG_fogShadowPreset(pixelDepth,x,y,quality));
+      else
+      {
+        pixel->position.y = y;
+        color = SFG_shadeColor(SFG_backgroundPixelPreset(pixel,quality),0);
+      }
+
+      SFG_setWorldPixel(x,y,color);
+
+#if SFG_FULL_Z_BUFFER
+      SFG_setWorldDepth(x,y,255);
 #endif
+
+      y += increment;
+    }
+  }
 }
 
+#if SFG_QUALITY_PRESETS
+void SFG_spanFuncLow(RCL_PixelInfo *pixel, RCL_SpanInfo *span)
+{
+  SFG_spanFuncPreset(pixel,span,SFG_QUALITY_LOW);
+}
+
+void SFG_spanFuncMedium(RCL_PixelInfo *pixel, RCL_SpanInfo *span)
+{
+  SFG_spanFuncPreset(pixel,span,SFG_QUALITY_MEDIUM);
+}
+
+void SFG_spanFuncHigh(RCL_PixelInfo *pixel, RCL_SpanInfo *span)
+{
+  SFG_spanFuncPreset(pixel,span,SFG_QUALITY_HIGH);
+}
+
+void (* const SFG_spanFuncs[SFG_QUALITY_PRESET_COUNT])(RCL_PixelInfo *,
+  RCL_SpanInfo *) = {SFG_spanFuncLow, SFG_spanFuncMedium, SFG_spanFuncHigh};
+
+void SFG_spanFunc(RCL_PixelInfo *pixel, RCL_SpanInfo *span)
+{
+  SFG_spanFuncs[SFG_game.quality](pixel,span);
+}
+#else
+void SFG_spanFunc(RCL_PixelInfo *pixel, RCL_SpanInfo *span)
+{
+  SFG_spanFuncPreset(pixel,span,SFG_QUALITY_HIGH);
+}
+#endif
+#endif
+
 /**
   Draws image on screen, with transparency. This is faster than sprite drawing.
   For performance sake drawing near screen edges is not pixel perfect.
@@ -1125,6 +2369,147 @@ void SFG_blitImage(
   }
 }
 
+#if SFG_FULL_Z_BUFFER
+/**
+  Computes the minimum and maximum values of given part of the rows of the full
+  z-buffer tiles, to be run by SFG_runInParallel.
+*/
+void SFG_updateDepthTiles(uint8_t part, uint8_t parts)
+{
+  for (uint16_t tileY = (part * SFG_DEPTH_TILES_Y) / parts;
+    tileY < ((part + 1) * SFG_DEPTH_TILES_Y) / parts; ++tileY)
+  {
+    uint16_t yFrom = tileY * SFG_DEPTH_TILE_SIZE;
+    uint16_t yTo = RCL_min(yFrom + SFG_DEPTH_TILE_SIZE,SFG_DEPTH_BUFFER_HEIGHT);
+
+    for (uint16_t tileX = 0; tileX < SFG_DEPTH_TILES_X; ++tileX)
+    {
+      uint16_t xFrom = tileX * SFG_DEPTH_TILE_SIZE;
+      uint16_t xTo =
+        RCL_min(xFrom + SFG_DEPTH_TILE_SIZE,SFG_DEPTH_BUFFER_WIDTH);
+
+      uint8_t minValue = 255, maxValue = 0;
+
+      for (uint16_t y = yFrom; y < yTo; ++y)
+      {
+        const uint8_t *row = SFG_depthBuffer.pixels +
+          y * SFG_DEPTH_BUFFER_WIDTH;
+
+        for (uint16_t x = xFrom; x < xTo; ++x)
+        {
+          minValue = RCL_min(minValue,row[x]);
+          maxValue = RCL_max(maxValue,row[x]);
+        }
+      }
+
+      SFG_depthBuffer.tileMin[tileY * SFG_DEPTH_TILES_X + tileX] = minValue;
+      SFG_depthBuffer.tileMax[tileY * SFG_DEPTH_TILES_X + tileX] = maxValue;
+    }
+  }
+}
+
+/**
+  Helper for drawing sprites with the full z-buffer. Finds the next range of
+  rows in game screen column x, starting at *from and not going past to, in
+  which a sprite with given z-buffer distance is in front of the walls. The
+  range is returned in *from and *rangeTo, 0 is returned if there is none.
+  Whole tiles are skipped or accepted with one compare, only the tiles crossed
+  by wall edges are compared pixel by pixel.
+*/
+static inline uint8_t SFG_spriteRowsInFront(int16_t x, uint8_t zDistance,
+  int16_t *from, int16_t to, int16_t *rangeTo)
+{
+  int16_t viewX = x / SFG_RAYCASTING_SUBSAMPLE;
+
+  const uint8_t *column = SFG_depthBuffer.pixels + viewX;
+  const uint8_t *tileMin =
+    SFG_depthBuffer.tileMin + viewX / SFG_DEPTH_TILE_SIZE;
+  const uint8_t *tileMax =
+    SFG_depthBuffer.tileMax + viewX / SFG_DEPTH_TILE_SIZE;
+
+  int16_t y = *from;
+
+  // skip the hidden rows, below the view (HUD) nothing is hidden
+
+  while (y <= to && y < SFG_DEPTH_BUFFER_HEIGHT)
+  {
+    int16_t tile = (y / SFG_DEPTH_TILE_SIZE) * SFG_DEPTH_TILES_X;
+
+    if (tileMax[tile] < zDistance)
+      y = RCL_min((y / SFG_DEPTH_TILE_SIZE + 1) * SFG_DEPTH_TILE_SIZE,
+        SFG_DEPTH_BUFFER_HEIGHT);
+    else if (tileMin[tile] >= zDistance ||
+      column[y * SFG_DEPTH_BUFFER_WIDTH] >= zDistance)
+      break;
+    else
+      y++;
+  }
+
+  if (y > to)
+    return 0;
+
+  *from = y;
+
+  // extend over the rows in front
+
+  while (y < to)
+  {
+    int16_t next = y + 1;
+
+    if (next >= SFG_DEPTH_BUFFER_HEIGHT)
+    {
+      y = to;
+      break;
+    }
+
+    int16_t tile = (next / SFG_DEPTH_TILE_SIZE) * SFG_DEPTH_TILES_X;
+
+    if (tileMin[tile] >= zDistance)
+      y = RCL_min(to,(next / SFG_DEPTH_TILE_SIZE + 1) *
+        SFG_DEPTH_TILE_SIZE - 1);
+    else if (tileMax[tile] >= zDistance &&
+      column[next * SFG_DEPTH_BUFFER_WIDTH] >= zDistance)
+      y = next;
+    else
+      break;
+  }
+
+  *rangeTo = y;
+
+  return 1;
+}
+#endif
+
+#if SFG_SORTED_SPRITES
+/**
+  Sprites of the current frame waiting to be drawn, kept sorted front to back,
+  and a mask of screen pixels already covered by drawn sprites, see
+  SFG_SORTED_SPRITES.
+*/
+struct
+{
+  struct
+  {
+    const uint8_t *image;
+    int16_t centerX;
+    int16_t centerY;
+    int16_t size;
+    uint8_t minusValue;
+    RCL_Unit distance;
+  } sprites[SFG_MAX_SPRITES];
+
+  uint8_t count;
+  uint32_t covered[SFG_GAME_RESOLUTION_X * SFG_SPRITE_COVER_WORDS]; /**< One
+                                    bit per pixel, column by column, the
+                                    lowest bit of each word is the topmost
+                                    row. */
+  int16_t coveredTop[SFG_GAME_RESOLUTION_X]; /**< Topmost covered row in each
+                                    column, > coveredBottom if there is
+                                    none. */
+  int16_t coveredBottom[SFG_GAME_RESOLUTION_X];
+} SFG_spriteQueue;
+#endif
+
 void SFG_drawScaledSprite(
   const uint8_t *image,
   int16_t centerX,
@@ -1210,95 +2595,385 @@ void SFG_drawScaledSprite(
     precompPosScaled += precompStepScaled;
   }
 
-  #undef PRECOMP_SCALE
-
   uint8_t zDistance = SFG_RCLUnitToZBuffer(distance);
 
+#if SFG_RLE_SPRITES
+  /* Only the runs of opaque texels are walked, each one is drawn to the rows
+     whose sampling points fall into it. */
+  const uint16_t *columns = SFG_rleSprites.columns[SFG_spriteIndex(image)];
+
   for (int16_t x = x0, u = u0; x <= x1; ++x, ++u)
   {
-    if (SFG_game.zBuffer[x] >= zDistance)
-    {
-      int8_t columnTransparent = 1;
+    if (SFG_game.zBuffer[x] < zDistance)
+      continue;
 
-      for (int16_t y = y0, v = v0; y <= y1; ++y, ++v)
-      {
-        uint8_t color =
-          SFG_getTexel(image,SFG_game.spriteSamplingPoints[u],
-            SFG_game.spriteSamplingPoints[v]);
+#if SFG_SORTED_SPRITES
+    uint32_t *covered = SFG_spriteQueue.covered + x * SFG_SPRITE_COVER_WORDS;
+    int16_t top = SFG_spriteQueue.coveredTop[x];
+    int16_t bottom = SFG_spriteQueue.coveredBottom[x];
+    int16_t newTop = top, newBottom = bottom;
+#else
+    int8_t columnTransparent = 1;
+#endif
 
-        if (color != SFG_TRANSPARENT_COLOR)
-        {
-#if SFG_DIMINISH_SPRITES
-          color = palette_minusValue(color,minusValue);
-#endif 
-          columnTransparent = 0;
+#if SFG_FULL_Z_BUFFER
+    int16_t rowsTo = -1; // last row known to be in front of the walls
+#endif
 
-          SFG_setGamePixel(x,y,color);
-        }
-      }
+    const uint8_t *run =
+      SFG_rleSprites.data + columns[SFG_game.spriteSamplingPoints[u]];
 
-      if (!columnTransparent)
-        SFG_game.zBuffer[x] = zDistance;
-    }
-  }
-}
+    for (uint8_t runCount = *run++; runCount > 0; --runCount)
+    {
+      uint8_t runStart = run[0];
+      uint8_t runLength = run[1];
+      const uint8_t *texels = run + 2;
 
-RCL_Unit SFG_texturesAt(int16_t x, int16_t y)
-{
-  uint8_t p;
+      run = texels + runLength;
 
-  SFG_TileDefinition tile =
-    SFG_getMapTile(SFG_currentLevel.levelPointer,x,y,&p);
+      // first rows with sampling points at or after the run start and end:
 
-  return
-    SFG_TILE_FLOOR_TEXTURE(tile) | (SFG_TILE_CEILING_TEXTURE(tile) << 3) | p;
-    // ^ store both textures (floor and ceiling) and properties in one number
-}
+      int16_t vFrom = ((int32_t) runStart * PRECOMP_SCALE +
+        precompStepScaled - 1) / precompStepScaled;
 
-RCL_Unit SFG_movingWallHeight
-(
-  RCL_Unit low,
-  RCL_Unit high,
-  uint32_t time    
-)
-{
-  RCL_Unit height = RCL_nonZero(high - low);
-  RCL_Unit halfHeight = height / 2;
+      if (vFrom > v1)
+        break;
 
-  RCL_Unit sinArg =
-    (time * ((SFG_MOVING_WALL_SPEED * RCL_UNITS_PER_SQUARE) / 1000)) / height;
+      int16_t vTo = ((int32_t) (runStart + runLength) * PRECOMP_SCALE +
+        precompStepScaled - 1) / precompStepScaled - 1;
 
-  return
-    low + halfHeight + (RCL_sin(sinArg) * halfHeight) / RCL_UNITS_PER_SQUARE;
-}
+      vFrom = RCL_max(vFrom,v0);
+      vTo = RCL_min(vTo,v1);
 
-RCL_Unit SFG_floorHeightAt(int16_t x, int16_t y)
-{
-  uint8_t properties;
+      for (int16_t v = vFrom, y = y0 + (vFrom - v0); v <= vTo; ++v, ++y)
+      {
+#if SFG_FULL_Z_BUFFER
+        if (y > rowsTo)
+        {
+          // find the next rows in front of the walls
 
-  SFG_TileDefinition tile =
-    SFG_getMapTile(SFG_currentLevel.levelPointer,x,y,&properties);
+          int16_t rowsFrom = y;
 
-  RCL_Unit doorHeight = 0;
+          if (!SFG_spriteRowsInFront(x,zDistance,&rowsFrom,
+            y0 + (vTo - v0),&rowsTo))
+            break;
 
-  if (properties == SFG_TILE_PROPERTY_DOOR)
-  {
-    for (uint8_t i = 0; i < SFG_currentLevel.doorRecordCount; ++i)
-    {
-      SFG_DoorRecord *door = &(SFG_currentLevel.doorRecords[i]);
+          v += rowsFrom - y;
+          y = rowsFrom;
+        }
+#endif
 
-      if ((door->coords[0] == x) && (door->coords[1] == y))
-      {
-        doorHeight = door->state & SFG_DOOR_VERTICAL_POSITION_MASK;
+#if SFG_SORTED_SPRITES
+        if (y >= top && y <= bottom &&
+          (covered[y / 32] & (((uint32_t) 1) << (y % 32))))
+          continue;
+#endif
 
-        doorHeight = doorHeight != (0xff & SFG_DOOR_VERTICAL_POSITION_MASK)    ? 
-          doorHeight * SFG_DOOR_HEIGHT_STEP : RCL_UNITS_PER_SQUARE;
+        uint8_t color = texels[SFG_game.spriteSamplingPoints[v] - runStart];
 
-        break;
+#if SFG_DIMINISH_SPRITES
+        color = palette_minusValue(color,minusValue);
+#endif
+        SFG_setGamePixel(x,y,color);
+
+#if SFG_SORTED_SPRITES
+        covered[y / 32] |= ((uint32_t) 1) << (y % 32);
+        newTop = RCL_min(newTop,y);
+        newBottom = RCL_max(newBottom,y);
+#else
+        columnTransparent = 0;
+#endif
       }
     }
-  }
-  else if (properties == SFG_TILE_PROPERTY_ELEVATOR)
+
+#if SFG_SORTED_SPRITES
+    SFG_spriteQueue.coveredTop[x] = newTop;
+    SFG_spriteQueue.coveredBottom[x] = newBottom;
+#else
+    if (!columnTransparent)
+      SFG_game.zBuffer[x] = zDistance;
+#endif
+  }
+#else // SFG_RLE_SPRITES
+
+#if SFG_DECODED_TEXTURES
+  const uint8_t *decoded = SFG_decodedSprite(image);
+#endif
+
+#if SFG_SORTED_SPRITES
+  /* Sprites come front to back here, so the per column z-buffer isn't written
+     and pixels covered by nearer sprites are skipped without sampling. */
+  for (int16_t x = x0, u = u0; x <= x1; ++x, ++u)
+  {
+    if (SFG_game.zBuffer[x] < zDistance)
+      continue;
+
+    uint32_t *covered = SFG_spriteQueue.covered + x * SFG_SPRITE_COVER_WORDS;
+    int16_t top = SFG_spriteQueue.coveredTop[x];
+    int16_t bottom = SFG_spriteQueue.coveredBottom[x];
+    int16_t newTop = top, newBottom = bottom;
+    int16_t y = y0, v = v0;
+
+#if SFG_FULL_Z_BUFFER
+    int16_t rowsTo = -1; // last row known to be in front of the walls
+#endif
+
+    while (y <= y1)
+    {
+#if SFG_FULL_Z_BUFFER
+      if (y > rowsTo)
+      {
+        // find the next rows in front of the walls
+
+        int16_t rowsFrom = y;
+
+        if (!SFG_spriteRowsInFront(x,zDistance,&rowsFrom,y1,&rowsTo))
+          break;
+
+        v += rowsFrom - y;
+        y = rowsFrom;
+      }
+#endif
+
+      if (y >= top && y <= bottom)
+      {
+        uint32_t word = covered[y / 32];
+
+        if (word == 0xffffffff)
+        {
+          // whole word covered, jump over it
+
+          int16_t next = (y / 32 + 1) * 32;
+
+          v += next - y;
+          y = next;
+          continue;
+        }
+
+        if (word & (((uint32_t) 1) << (y % 32)))
+        {
+          y++;
+          v++;
+          continue;
+        }
+      }
+
+      uint8_t color =
+#if SFG_DECODED_TEXTURES
+        SFG_getDecodedTexel(decoded,SFG_game.spriteSamplingPoints[u],
+          SFG_game.spriteSamplingPoints[v]);
+#else
+        SFG_getTexel(image,SFG_game.spriteSamplingPoints[u],
+          SFG_game.spriteSamplingPoints[v]);
+#endif
+
+      if (color != SFG_TRANSPARENT_COLOR)
+      {
+#if SFG_DIMINISH_SPRITES
+        color = palette_minusValue(color,minusValue);
+#endif
+        SFG_setGamePixel(x,y,color);
+
+        covered[y / 32] |= ((uint32_t) 1) << (y % 32);
+        newTop = RCL_min(newTop,y);
+        newBottom = RCL_max(newBottom,y);
+      }
+
+      y++;
+      v++;
+    }
+
+    SFG_spriteQueue.coveredTop[x] = newTop;
+    SFG_spriteQueue.coveredBottom[x] = newBottom;
+  }
+#else
+  for (int16_t x = x0, u = u0; x <= x1; ++x, ++u)
+  {
+    if (SFG_game.zBuffer[x] >= zDistance)
+    {
+      int8_t columnTransparent = 1;
+
+#if SFG_FULL_Z_BUFFER
+      int16_t rowsTo = -1; // last row known to be in front of the walls
+#endif
+
+      for (int16_t y = y0, v = v0; y <= y1; ++y, ++v)
+      {
+#if SFG_FULL_Z_BUFFER
+        if (y > rowsTo)
+        {
+          // find the next rows in front of the walls
+
+          int16_t rowsFrom = y;
+
+          if (!SFG_spriteRowsInFront(x,zDistance,&rowsFrom,y1,&rowsTo))
+            break;
+
+          v += rowsFrom - y;
+          y = rowsFrom;
+        }
+#endif
+
+        uint8_t color =
+#if SFG_DECODED_TEXTURES
+          SFG_getDecodedTexel(decoded,SFG_game.spriteSamplingPoints[u],
+            SFG_game.spriteSamplingPoints[v]);
+#else
+          SFG_getTexel(image,SFG_game.spriteSamplingPoints[u],
+            SFG_game.spriteSamplingPoints[v]);
+#endif
+
+        if (color != SFG_TRANSPARENT_COLOR)
+        {
+#if SFG_DIMINISH_SPRITES
+          color = palette_minusValue(color,minusValue);
+#endif 
+          columnTransparent = 0;
+
+          SFG_setGamePixel(x,y,color);
+        }
+      }
+
+      if (!columnTransparent)
+        SFG_game.zBuffer[x] = zDistance;
+    }
+  }
+#endif
+#endif // SFG_RLE_SPRITES
+
+  #undef PRECOMP_SCALE
+}
+
+/**
+  Draws a sprite of the 3D view, or with SFG_SORTED_SPRITES only adds it to the
+  list drawn later by SFG_drawSpriteQueue. Parameters are the same as for
+  SFG_drawScaledSprite.
+*/
+static inline void SFG_submitSprite(
+  const uint8_t *image,
+  int16_t centerX,
+  int16_t centerY,
+  int16_t size,
+  uint8_t minusValue,
+  RCL_Unit distance)
+{
+#if SFG_SORTED_SPRITES
+  if (size == 0 || SFG_spriteQueue.count >= SFG_MAX_SPRITES)
+    return;
+
+  // insert sorted by distance, records of the same distance keep their order
+
+  uint8_t i = SFG_spriteQueue.count;
+
+  while (i > 0 && SFG_spriteQueue.sprites[i - 1].distance > distance)
+  {
+    SFG_spriteQueue.sprites[i] = SFG_spriteQueue.sprites[i - 1];
+    i--;
+  }
+
+  SFG_spriteQueue.sprites[i].image = image;
+  SFG_spriteQueue.sprites[i].centerX = centerX;
+  SFG_spriteQueue.sprites[i].centerY = centerY;
+  SFG_spriteQueue.sprites[i].size = size;
+  SFG_spriteQueue.sprites[i].minusValue = minusValue;
+  SFG_spriteQueue.sprites[i].distance = distance;
+
+  SFG_spriteQueue.count++;
+#else
+  SFG_drawScaledSprite(image,centerX,centerY,size,minusValue,distance);
+#endif
+}
+
+#if SFG_SORTED_SPRITES
+/**
+  Draws the sprites collected by SFG_submitSprite front to back and empties the
+  list.
+*/
+void SFG_drawSpriteQueue(void)
+{
+  // clear the mask, only the words that got covered in the previous frame
+
+  for (uint16_t i = 0; i < SFG_GAME_RESOLUTION_X; ++i)
+  {
+    uint32_t *covered = SFG_spriteQueue.covered + i * SFG_SPRITE_COVER_WORDS;
+
+    for (int16_t j = SFG_spriteQueue.coveredTop[i] / 32;
+      j <= SFG_spriteQueue.coveredBottom[i] / 32; ++j)
+      covered[j] = 0;
+
+    SFG_spriteQueue.coveredTop[i] = SFG_GAME_RESOLUTION_Y;
+    SFG_spriteQueue.coveredBottom[i] = -1;
+  }
+
+  for (uint8_t i = 0; i < SFG_spriteQueue.count; ++i)
+    SFG_drawScaledSprite(
+      SFG_spriteQueue.sprites[i].image,
+      SFG_spriteQueue.sprites[i].centerX,
+      SFG_spriteQueue.sprites[i].centerY,
+      SFG_spriteQueue.sprites[i].size,
+      SFG_spriteQueue.sprites[i].minusValue,
+      SFG_spriteQueue.sprites[i].distance);
+
+  SFG_spriteQueue.count = 0;
+}
+#endif
+
+RCL_Unit SFG_texturesAt(int16_t x, int16_t y)
+{
+  uint8_t p;
+
+  SFG_TileDefinition tile =
+    SFG_getMapTile(SFG_currentLevel.levelPointer,x,y,&p);
+
+  return
+    SFG_TILE_FLOOR_TEXTURE(tile) | (SFG_TILE_CEILING_TEXTURE(tile) << 3) | p;
+    // ^ store both textures (floor and ceiling) and properties in one number
+}
+
+RCL_Unit SFG_movingWallHeight
+(
+  RCL_Unit low,
+  RCL_Unit high,
+  uint32_t time    
+)
+{
+  RCL_Unit height = RCL_nonZero(high - low);
+  RCL_Unit halfHeight = height / 2;
+
+  RCL_Unit sinArg =
+    (time * ((SFG_MOVING_WALL_SPEED * RCL_UNITS_PER_SQUARE) / 1000)) / height;
+
+  return
+    low + halfHeight + (RCL_sin(sinArg) * halfHeight) / RCL_UNITS_PER_SQUARE;
+}
+
+RCL_Unit SFG_floorHeightAt(int16_t x, int16_t y)
+{
+  uint8_t properties;
+
+  SFG_TileDefinition tile =
+    SFG_getMapTile(SFG_currentLevel.levelPointer,x,y,&properties);
+
+  RCL_Unit doorHeight = 0;
+
+  if (properties == SFG_TILE_PROPERTY_DOOR)
+  {
+    for (uint8_t i = 0; i < SFG_currentLevel.doorRecordCount; ++i)
+    {
+      SFG_DoorRecord *door = &(SFG_currentLevel.doorRecords[i]);
+
+      if ((door->coords[0] == x) && (door->coords[1] == y))
+      {
+        doorHeight = door->state & SFG_DOOR_VERTICAL_POSITION_MASK;
+
+        doorHeight = doorHeight != (0xff & SFG_DOOR_VERTICAL_POSITION_MASK)    ? 
+          doorHeight * SFG_DOOR_HEIGHT_STEP : RCL_UNITS_PER_SQUARE;
+
+        break;
+      }
+    }
+  }
+  else if (properties == SFG_TILE_PROPERTY_ELEVATOR)
   {
     RCL_Unit height =
       SFG_TILE_FLOOR_HEIGHT(tile) * SFG_WALL_HEIGHT_STEP;
@@ -1444,81 +3119,322 @@ RCL_Unit SFG_ceilingHeightAt(int16_t x, int16_t y)
       SFG_game.frameTime - SFG_currentLevel.timeStart);
 }
 
+#if SFG_SQUARE_GRID
 /**
-  Gets sprite (image and sprite size) for given item.
+  Recomputes the heights of a square grid square given by its index.
 */
-void SFG_getItemSprite(
-  uint8_t elementType, const uint8_t **sprite, uint8_t *spriteSize)
+static inline void SFG_updateGridSquareHeights(uint16_t index)
 {
-  *spriteSize = 0;
-  *sprite = SFG_itemSprites + (elementType - 1) * SFG_TEXTURE_STORE_SIZE;
+  RCL_GridSquare *square = SFG_currentLevel.squareGrid + index;
 
-  switch (elementType)
-  {
-    case SFG_LEVEL_ELEMENT_TREE:
-    case SFG_LEVEL_ELEMENT_RUIN:
-    case SFG_LEVEL_ELEMENT_LAMP:
-    case SFG_LEVEL_ELEMENT_TELEPORTER:
-      *spriteSize = 2;
-      break;
+  square->floorHeight =
+    SFG_floorHeightAt(index % SFG_MAP_SIZE,index / SFG_MAP_SIZE);
 
-    case SFG_LEVEL_ELEMENT_TERMINAL:
-      *spriteSize = 1;
-      break;
+  square->ceilingHeight =
+    SFG_ceilingHeightAt(index % SFG_MAP_SIZE,index / SFG_MAP_SIZE);
+}
 
-    case SFG_LEVEL_ELEMENT_FINISH:
-    case SFG_LEVEL_ELEMENT_COLUMN:
-      *spriteSize = 3;
-      break;
+/**
+  Computes the whole square grid used for rendering for the current level and
+  records the squares whose heights can change (doors, elevators and
+  squeezers).
+*/
+void SFG_initSquareGrid(void)
+{
+  RCL_GridSquare *square = SFG_currentLevel.squareGrid;
 
-    case SFG_LEVEL_ELEMENT_CARD0:
-    case SFG_LEVEL_ELEMENT_CARD1:
-    case SFG_LEVEL_ELEMENT_CARD2:
-      *sprite = SFG_itemSprites + 
-        (SFG_LEVEL_ELEMENT_CARD0 - 1) * SFG_TEXTURE_STORE_SIZE;
-      break;
+  SFG_currentLevel.gridDynamicSquareCount = 0;
 
-    case SFG_LEVEL_ELEMENT_BLOCKER:
-      *sprite = 0;
-      break;
+  for (uint16_t i = 0; i < SFG_MAP_SIZE * SFG_MAP_SIZE; ++i)
+  {
+    square->type = SFG_texturesAt(i % SFG_MAP_SIZE,i / SFG_MAP_SIZE);
+    square->blockLevel = 0;
 
-    default:
-      break;
+    SFG_updateGridSquareHeights(i);
+
+    if ((square->type & SFG_TILE_PROPERTY_MASK) != SFG_TILE_PROPERTY_NORMAL)
+    {
+      if (SFG_currentLevel.gridDynamicSquareCount <
+        SFG_MAX_GRID_DYNAMIC_SQUARES)
+        SFG_currentLevel.gridDynamicSquares[
+          SFG_currentLevel.gridDynamicSquareCount] = i;
+
+      SFG_currentLevel.gridDynamicSquareCount++;
+    }
+
+    square++;
   }
+
+  if (SFG_currentLevel.gridDynamicSquareCount > SFG_MAX_GRID_DYNAMIC_SQUARES)
+    SFG_LOG("warning: too many dynamic squares, searching the whole grid")
 }
 
 /**
-  Says whether given item type collides, i.e. stops player from moving.
+  Recomputes the heights of the square grid squares that can change (doors,
+  elevators and squeezers).
 */
-uint8_t SFG_itemCollides(uint8_t elementType)
+void SFG_updateSquareGrid(void)
 {
-  return 
-    elementType == SFG_LEVEL_ELEMENT_BARREL ||
-    elementType == SFG_LEVEL_ELEMENT_TREE ||
-    elementType == SFG_LEVEL_ELEMENT_TERMINAL ||
-    elementType == SFG_LEVEL_ELEMENT_COLUMN ||
-    elementType == SFG_LEVEL_ELEMENT_RUIN ||
-    elementType == SFG_LEVEL_ELEMENT_BLOCKER ||
-    elementType == SFG_LEVEL_ELEMENT_LAMP;
+  if (SFG_currentLevel.gridDynamicSquareCount <= SFG_MAX_GRID_DYNAMIC_SQUARES)
+  {
+    for (uint16_t i = 0; i < SFG_currentLevel.gridDynamicSquareCount; ++i)
+      SFG_updateGridSquareHeights(SFG_currentLevel.gridDynamicSquares[i]);
+  }
+  else
+  {
+    for (uint16_t i = 0; i < SFG_MAP_SIZE * SFG_MAP_SIZE; ++i)
+      if ((SFG_currentLevel.squareGrid[i].type & SFG_TILE_PROPERTY_MASK) !=
+        SFG_TILE_PROPERTY_NORMAL)
+        SFG_updateGridSquareHeights(i);
+  }
 }
 
-void SFG_setGameState(uint8_t state)
+#if SFG_SKIP_UNIFORM_BLOCKS
+/**
+  Finds the uniform blocks of the square grid which rays can skip at once (see
+  RCL_GridSquare::blockLevel). A pyramid is built over the map, each of its
+  levels halving the resolution of the previous one: a block is uniform if its
+  four sub-blocks are uniform and have the same heights. Squares whose heights
+  can change (doors, elevators, ...) are never uniform.
+*/
+void SFG_computeSquareGridBlocks(void)
 {
-  SFG_LOG("changing game state");
-  SFG_game.state = state;
-  SFG_game.stateTime = 0;
-}
+  RCL_GridSquare *grid = SFG_currentLevel.squareGrid;
 
-void SFG_setAndInitLevel(uint8_t levelNumber)
-{
-  SFG_LOG("setting and initializing level");
+  /* Current pyramid level, each level is computed in place over the previous
+     one, which is possible as a block only reads sub-blocks with the same or
+     higher index. */
+  int16_t floors[(SFG_MAP_SIZE / 2) * (SFG_MAP_SIZE / 2)];
+  int16_t ceilings[(SFG_MAP_SIZE / 2) * (SFG_MAP_SIZE / 2)];
+  uint8_t uniform[(SFG_MAP_SIZE / 2) * (SFG_MAP_SIZE / 2)];
 
-  const SFG_Level *level;
+  for (uint8_t level = 1; (SFG_MAP_SIZE >> level) > 0; ++level)
+  {
+    uint8_t size = SFG_MAP_SIZE >> level;
+    uint8_t blockSide = 1 << level;
 
-#if SFG_AVR
-  memcpy_P(&SFG_ramLevel,SFG_levels[levelNumber],sizeof(SFG_Level));
-  level = &SFG_ramLevel;
-#else
+    for (uint8_t y = 0; y < size; ++y)
+      for (uint8_t x = 0; x < size; ++x)
+      {
+        int16_t f[4], c[4];
+        uint8_t u = 1;
+
+        for (uint8_t i = 0; i < 4; ++i)
+        {
+          uint8_t subX = 2 * x + (i % 2), subY = 2 * y + (i / 2);
+
+          if (level == 1)
+          {
+            RCL_GridSquare *s = grid + subY * SFG_MAP_SIZE + subX;
+
+            f[i] = s->floorHeight;
+            c[i] = s->ceilingHeight;
+
+            u &= (s->type & SFG_TILE_PROPERTY_MASK) ==
+              SFG_TILE_PROPERTY_NORMAL;
+          }
+          else
+          {
+            uint16_t index = subY * size * 2 + subX;
+
+            f[i] = floors[index];
+            c[i] = ceilings[index];
+            u &= uniform[index];
+          }
+
+          u &= f[i] == f[0] && c[i] == c[0];
+        }
+
+        uint16_t index = y * size + x;
+
+        floors[index] = f[0];
+        ceilings[index] = c[0];
+        uniform[index] = u;
+
+        if (u)
+          for (uint8_t by = 0; by < blockSide; ++by)
+            for (uint8_t bx = 0; bx < blockSide; ++bx)
+              grid[(y * blockSide + by) * SFG_MAP_SIZE + x * blockSide + bx].
+                blockLevel = level;
+      }
+  }
+}
+#endif
+#endif
+
+#if SFG_ADAPTIVE_RAY_BUDGETS
+/**
+  Sets the ray budgets of the screen columns for the next frame from what they
+  needed in the last rendered frame (see SFG_ADAPTIVE_RAY_BUDGETS) and counts
+  the budget overruns. If full is non-zero, or periodically, all budgets are
+  reset to the full ray constraints.
+*/
+void SFG_updateRayBudgets(uint8_t full)
+{
+  RCL_ColumnInfo *info = SFG_game.rayColumnInfo;
+  RCL_RayConstraints c = SFG_game.rayConstraints;
+  int16_t columns = SFG_player.camera.resolution.x;
+
+  uint16_t neededSteps[SFG_GAME_RESOLUTION_X];
+  uint16_t neededHits[SFG_GAME_RESOLUTION_X];
+
+  if (SFG_game.frame - SFG_game.rayBudgetRefreshFrame >=
+    SFG_RAY_BUDGET_REFRESH_FRAMES)
+    full = 1;
+
+  /* When the camera turns, a column shows what a column up to this many
+     columns away showed in the last frame (twice the average number of
+     columns per angle, as the columns are denser towards the view edges). */
+  RCL_Unit turn = RCL_wrap(SFG_player.camera.direction -
+    SFG_game.rayBudgetDirection + RCL_UNITS_PER_SQUARE / 2,
+    RCL_UNITS_PER_SQUARE) - RCL_UNITS_PER_SQUARE / 2;
+
+  int16_t shift = 1 + (2 * RCL_abs(turn) * columns) / RCL_HORIZONTAL_FOV;
+
+  SFG_game.rayBudgetDirection = SFG_player.camera.direction;
+
+  if (shift >= columns)
+    full = 1;
+
+  if (full)
+    SFG_game.rayBudgetRefreshFrame = SFG_game.frame;
+
+  SFG_game.rayBudgetOverruns = 0;
+
+  for (int16_t i = 0; i < columns; ++i)
+  {
+    /* The column may have needed more than it got if it used up its whole
+       budget, in which case it needs the full constraints next time. */
+    uint8_t overrun = !full &&
+      ((info[i].maxSteps < c.maxSteps && info[i].usedSteps >= info[i].maxSteps)
+      || (info[i].maxHits < c.maxHits && info[i].usedHits >= info[i].maxHits));
+
+    if (full || overrun)
+    {
+      neededSteps[i] = c.maxSteps;
+      neededHits[i] = c.maxHits;
+    }
+    else
+    {
+      neededSteps[i] =
+        RCL_min(info[i].usedSteps + SFG_RAY_BUDGET_MARGIN_STEPS,c.maxSteps);
+
+      neededHits[i] =
+        RCL_min(info[i].usedHits + SFG_RAY_BUDGET_MARGIN_HITS,c.maxHits);
+    }
+
+    SFG_game.rayBudgetOverruns += overrun;
+  }
+
+  for (int16_t i = 0; i < columns; ++i)
+  {
+    uint16_t steps = c.maxSteps, hits = c.maxHits;
+
+    // columns near the view edges may show what was outside the last view
+    if (i - shift >= 0 && i + shift < columns)
+    {
+      steps = 0;
+      hits = 0;
+
+      for (int16_t j = i - shift; j <= i + shift; ++j)
+      {
+        steps = RCL_max(steps,neededSteps[j]);
+        hits = RCL_max(hits,neededHits[j]);
+      }
+    }
+
+    info[i].maxSteps = steps;
+    info[i].maxHits = hits;
+
+    /* Nothing may get rendered with these budgets before the next update
+       (e.g. after a level start), so record them as fully used
+       so that the next update doesn't lower them. */
+    if (full)
+    {
+      info[i].usedSteps = steps;
+      info[i].usedHits = hits;
+    }
+  }
+
+  SFG_game.rayBudgetOverrunsTotal += SFG_game.rayBudgetOverruns;
+}
+#endif
+
+/**
+  Gets sprite (image and sprite size) for given item.
+*/
+void SFG_getItemSprite(
+  uint8_t elementType, const uint8_t **sprite, uint8_t *spriteSize)
+{
+  *spriteSize = 0;
+  *sprite = SFG_itemSprites + (elementType - 1) * SFG_TEXTURE_STORE_SIZE;
+
+  switch (elementType)
+  {
+    case SFG_LEVEL_ELEMENT_TREE:
+    case SFG_LEVEL_ELEMENT_RUIN:
+    case SFG_LEVEL_ELEMENT_LAMP:
+    case SFG_LEVEL_ELEMENT_TELEPORTER:
+      *spriteSize = 2;
+      break;
+
+    case SFG_LEVEL_ELEMENT_TERMINAL:
+      *spriteSize = 1;
+      break;
+
+    case SFG_LEVEL_ELEMENT_FINISH:
+    case SFG_LEVEL_ELEMENT_COLUMN:
+      *spriteSize = 3;
+      break;
+
+    case SFG_LEVEL_ELEMENT_CARD0:
+    case SFG_LEVEL_ELEMENT_CARD1:
+    case SFG_LEVEL_ELEMENT_CARD2:
+      *sprite = SFG_itemSprites + 
+        (SFG_LEVEL_ELEMENT_CARD0 - 1) * SFG_TEXTURE_STORE_SIZE;
+      break;
+
+    case SFG_LEVEL_ELEMENT_BLOCKER:
+      *sprite = 0;
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+  Says whether given item type collides, i.e. stops player from moving.
+*/
+uint8_t SFG_itemCollides(uint8_t elementType)
+{
+  return 
+    elementType == SFG_LEVEL_ELEMENT_BARREL ||
+    elementType == SFG_LEVEL_ELEMENT_TREE ||
+    elementType == SFG_LEVEL_ELEMENT_TERMINAL ||
+    elementType == SFG_LEVEL_ELEMENT_COLUMN ||
+    elementType == SFG_LEVEL_ELEMENT_RUIN ||
+    elementType == SFG_LEVEL_ELEMENT_BLOCKER ||
+    elementType == SFG_LEVEL_ELEMENT_LAMP;
+}
+
+void SFG_setGameState(uint8_t state)
+{
+  SFG_LOG("changing game state");
+  SFG_game.state = state;
+  SFG_game.stateTime = 0;
+}
+
+void SFG_setAndInitLevel(uint8_t levelNumber)
+{
+  SFG_LOG("setting and initializing level");
+
+  const SFG_Level *level;
+
+#if SFG_AVR
+  memcpy_P(&SFG_ramLevel,SFG_levels[levelNumber],sizeof(SFG_Level));
+  level = &SFG_ramLevel;
+#else
   level = SFG_levels[levelNumber];
 #endif
 
@@ -1540,6 +3456,21 @@ void SFG_setAndInitLevel(uint8_t levelNumber)
     SFG_currentLevel.textures[i] =
       SFG_wallTextures + level->textureIndices[i] * SFG_TEXTURE_STORE_SIZE;
 
+#if SFG_DECODED_TEXTURES
+  SFG_LOG("decoding textures");
+
+  for (uint8_t i = 0; i < 7; ++i)
+    SFG_decodeImage(SFG_currentLevel.textures[i],SFG_decodedImages.walls[i]);
+
+  SFG_decodeImage(SFG_wallTextures + level->doorTextureIndex *
+    SFG_TEXTURE_STORE_SIZE,SFG_decodedImages.walls[7]);
+#endif
+
+#if SFG_DECODED_TEXTURES || SFG_PRESCALED_BACKGROUND
+  SFG_decodeImage(SFG_backgroundImages + level->backgroundImage *
+    SFG_TEXTURE_STORE_SIZE,SFG_decodedImages.background);
+#endif
+
   SFG_LOG("initializing doors");
 
   SFG_currentLevel.checkedDoorIndex = 0;
@@ -1553,6 +3484,10 @@ void SFG_setAndInitLevel(uint8_t levelNumber)
     0;
 #endif
 
+#if SFG_CACHED_MAP
+  SFG_currentLevel.mapColorsMask = 0;
+#endif
+
   for (uint8_t j = 0; j < SFG_MAP_SIZE; ++j)
   {
     for (uint8_t i = 0; i < SFG_MAP_SIZE; ++i)
@@ -1665,9 +3600,43 @@ void SFG_setAndInitLevel(uint8_t levelNumber)
   SFG_currentLevel.timeStart = SFG_game.frameTime; 
   SFG_currentLevel.frameStart = SFG_game.frame;
 
+#if SFG_SQUARE_GRID
+  SFG_LOG("precomputing square grid")
+
+  SFG_initSquareGrid();
+
+#if SFG_SKIP_UNIFORM_BLOCKS
+  SFG_computeSquareGridBlocks();
+#endif
+
+  RCL_GridSquare outside;
+
+  outside.floorHeight = SFG_floorHeightAt(-1,-1);
+  outside.ceilingHeight = SFG_ceilingHeightAt(-1,-1);
+  outside.type = SFG_texturesAt(-1,-1);
+  outside.blockLevel = 0;
+
+  RCL_setSquareGrid(SFG_currentLevel.squareGrid,SFG_MAP_SIZE,SFG_MAP_SIZE,
+    outside);
+#endif
+
   SFG_game.spriteAnimationFrame = 0;
 
+#if SFG_KEEP_VIEW
+  SFG_viewCache.valid = 0;
+  SFG_viewCache.complete = 0;
+#endif
+
   SFG_initPlayer();
+
+#if SFG_ADAPTIVE_RAY_BUDGETS
+  SFG_updateRayBudgets(1);
+#endif
+
+#if SFG_VIEW_SPRITE_VISIBILITY
+  SFG_game.viewColumns = 0;
+#endif
+
   SFG_setGameState(SFG_GAME_STATE_LEVEL_START);
   SFG_setMusic(SFG_MUSIC_NEXT);
   SFG_processEvent(SFG_EVENT_LEVEL_STARTS,levelNumber);
@@ -1701,8 +3670,66 @@ void SFG_init(void)
   SFG_game.visibilityRayConstraints.maxSteps =
     SFG_RAYCASTING_VISIBILITY_MAX_STEPS;
 
+#if SFG_ADAPTIVE_RAY_BUDGETS
+  SFG_game.rayBudgetOverrunsTotal = 0;
+#elif SFG_VIEW_SPRITE_VISIBILITY
+  // only the depths are wanted, so the budgets don't limit the rays
+
+  for (uint16_t i = 0; i < SFG_GAME_RESOLUTION_X; ++i)
+  {
+    SFG_game.rayColumnInfo[i].maxHits = 0xffff;
+    SFG_game.rayColumnInfo[i].maxSteps = 0xffff;
+  }
+#endif
+
+#if SFG_ADAPTIVE_RAY_BUDGETS || SFG_VIEW_SPRITE_VISIBILITY
+  RCL_setColumnInfo(SFG_game.rayColumnInfo);
+#endif
+
+#if SFG_VIEW_SPRITE_VISIBILITY
+  SFG_game.viewColumns = 0;
+#endif
+
+#if SFG_DYNAMIC_RESOLUTION
+  SFG_game.resolutionScaleX = 1;
+  SFG_game.resolutionScaleY = 1;
+  SFG_game.loadSum = 0;
+  SFG_game.loadFrames = 0;
+#endif
+
   SFG_game.antiSpam = 0;
 
+#if SFG_RENDER_THREADS > 1
+  SFG_LOG("starting render threads")
+
+  SFG_initThreadPool();
+#endif
+
+#if SFG_POST_PROCESS
+  SFG_postProcess.passes = 0;
+  SFG_setPostProcess(SFG_POST_PROCESS_PASSES);
+#endif
+
+#if SFG_QUALITY_PRESETS
+  SFG_setQuality(SFG_DEFAULT_QUALITY);
+#endif
+
+#if SFG_CACHED_HUD
+  for (uint8_t i = 0; i < sizeof(SFG_font) / sizeof(SFG_font[0]); ++i)
+    for (uint8_t j = 0; j < SFG_FONT_CHARACTER_SIZE; ++j)
+    {
+      SFG_glyphRows[i][j] = 0;
+
+      // the font is stored by columns
+      for (uint8_t k = 0; k < SFG_FONT_CHARACTER_SIZE; ++k)
+        if ((SFG_font[i] << (k * SFG_FONT_CHARACTER_SIZE + j)) & 0x8000)
+          SFG_glyphRows[i][j] |= 0x08 >> k;
+    }
+
+  SFG_hudCache.valid = 0;
+  SFG_hudCache.composing = 0;
+#endif
+
   SFG_LOG("computing average texture colors")
 
   for (uint8_t i = 0; i < SFG_WALL_TEXTURE_COUNT; ++i)
@@ -1748,6 +3775,102 @@ void SFG_init(void)
     SFG_game.backgroundScaleMap[i] =
       (i * SFG_TEXTURE_SIZE) / SFG_GAME_RESOLUTION_Y;
 
+#if SFG_MIPMAPS
+  SFG_LOG("computing MIP maps")
+
+  for (uint8_t i = 0; i < SFG_WALL_TEXTURE_COUNT; ++i)
+  {
+    uint8_t *mipmap = SFG_game.mipmaps[i];
+    const uint8_t *previous = 0;
+
+    for (uint8_t size = SFG_TEXTURE_SIZE / 2; size > 0; size /= 2)
+    {
+      for (uint8_t x = 0; x < size; ++x)
+        for (uint8_t y = 0; y < size; ++y)
+        {
+          // take the most common color of the four texels of the bigger level
+
+          uint8_t texels[4];
+
+          for (uint8_t j = 0; j < 4; ++j)
+          {
+            uint8_t x2 = 2 * x + j / 2, y2 = 2 * y + j % 2;
+
+            texels[j] = previous == 0 ?
+              SFG_getTexel(SFG_wallTextures + i * SFG_TEXTURE_STORE_SIZE,x2,y2)
+              : previous[x2 * size * 2 + y2];
+          }
+
+          uint8_t best = 0, bestCount = 0;
+
+          for (uint8_t j = 0; j < 4; ++j)
+          {
+            uint8_t count = 0;
+
+            for (uint8_t k = 0; k < 4; ++k)
+              count += texels[k] == texels[j];
+
+            if (count > bestCount)
+            {
+              best = texels[j];
+              bestCount = count;
+            }
+          }
+
+          mipmap[x * size + y] = best;
+        }
+
+      previous = mipmap;
+      mipmap += size * size;
+    }
+  }
+#endif
+
+#if SFG_DECODED_TEXTURES
+  SFG_LOG("decoding sprites")
+
+  uint8_t *decodedSprite = SFG_decodedImages.sprites[0];
+
+  for (uint16_t i = 0; i < sizeof(SFG_monsterSprites);
+    i += SFG_TEXTURE_STORE_SIZE, decodedSprite += SFG_DECODED_IMAGE_SIZE)
+    SFG_decodeImage(SFG_monsterSprites + i,decodedSprite);
+
+  for (uint16_t i = 0; i < sizeof(SFG_itemSprites);
+    i += SFG_TEXTURE_STORE_SIZE, decodedSprite += SFG_DECODED_IMAGE_SIZE)
+    SFG_decodeImage(SFG_itemSprites + i,decodedSprite);
+
+  for (uint16_t i = 0; i < sizeof(SFG_effectSprites);
+    i += SFG_TEXTURE_STORE_SIZE, decodedSprite += SFG_DECODED_IMAGE_SIZE)
+    SFG_decodeImage(SFG_effectSprites + i,decodedSprite);
+#endif
+
+#if SFG_RLE_SPRITES
+  SFG_LOG("run-length encoding sprites")
+
+  uint16_t rleOffset = 0;
+  uint16_t (*rleColumns)[SFG_TEXTURE_SIZE] = SFG_rleSprites.columns;
+
+  for (uint16_t i = 0; i < sizeof(SFG_monsterSprites);
+    i += SFG_TEXTURE_STORE_SIZE, rleColumns++)
+    SFG_encodeSprite(SFG_monsterSprites + i,*rleColumns,&rleOffset);
+
+  for (uint16_t i = 0; i < sizeof(SFG_itemSprites);
+    i += SFG_TEXTURE_STORE_SIZE, rleColumns++)
+    SFG_encodeSprite(SFG_itemSprites + i,*rleColumns,&rleOffset);
+
+  for (uint16_t i = 0; i < sizeof(SFG_effectSprites);
+    i += SFG_TEXTURE_STORE_SIZE, rleColumns++)
+    SFG_encodeSprite(SFG_effectSprites + i,*rleColumns,&rleOffset);
+#endif
+
+#if SFG_SHADE_TABLES
+  SFG_LOG("computing shade tables")
+
+  for (uint8_t i = 0; i < SFG_SHADE_LEVELS; ++i)
+    for (uint16_t j = 0; j < 256; ++j)
+      SFG_game.shadeTable[i][j] = SFG_computeShadedColor(j,i);
+#endif
+
   for (uint8_t i = 0; i < SFG_KEY_COUNT; ++i)
     SFG_game.keyStates[i] = 0;
 
@@ -2044,6 +4167,62 @@ static inline uint8_t SFG_spriteIsVisible(RCL_Vector2D pos, RCL_Unit height)
     ) == RCL_UNITS_PER_SQUARE;
 }
 
+/**
+  Checks visibility of a sprite drawn in the 3D view, given also its center X
+  position, size (both in game screen pixels) and depth. With
+  SFG_VIEW_SPRITE_VISIBILITY this is first decided from the depths the last
+  render of the view recorded for the screen columns: the sprite is hidden if
+  all columns it spans got fully covered in front of it and visible if nothing
+  was hit in front of it in the columns around its center. Only if neither is
+  the case a 3D ray is cast.
+*/
+static inline uint8_t SFG_spriteIsVisibleInView(RCL_Vector2D pos,
+  RCL_Unit height, RCL_Unit centerX, RCL_Unit size, RCL_Unit depth)
+{
+#if SFG_VIEW_SPRITE_VISIBILITY
+  int16_t columns = SFG_game.viewColumns;
+
+  if (columns != 0)
+  {
+    const RCL_ColumnInfo *info = SFG_game.rayColumnInfo;
+
+#if SFG_DYNAMIC_RESOLUTION
+    RCL_Unit columnWidth =
+      SFG_RAYCASTING_SUBSAMPLE * SFG_game.resolutionScaleX;
+#else
+    RCL_Unit columnWidth = SFG_RAYCASTING_SUBSAMPLE;
+#endif
+
+    // the center lies between the rays of these two columns:
+
+    RCL_Unit column = centerX / columnWidth;
+
+    if (column >= 0 && column + 1 < columns &&
+      info[column].firstHitDepth > depth &&
+      info[column + 1].firstHitDepth > depth)
+      return 1;
+
+    RCL_Unit from = RCL_max(0,(centerX - size / 2) / columnWidth);
+    RCL_Unit to = RCL_min(columns - 1,(centerX + size / 2) / columnWidth);
+
+    if (from <= to)
+    {
+      while (from <= to && info[from].coverDepth < depth)
+        from++;
+
+      if (from > to)
+        return 0;
+    }
+  }
+#else
+  SFG_UNUSED(centerX)
+  SFG_UNUSED(size)
+  SFG_UNUSED(depth)
+#endif
+
+  return SFG_spriteIsVisible(pos,height);
+}
+
 RCL_Unit SFG_directionTangent(RCL_Unit dirX, RCL_Unit dirY, RCL_Unit dirZ)
 {
   RCL_Vector2D v;
@@ -2985,15 +5164,65 @@ static inline uint16_t SFG_getMapRevealBit(uint8_t squareX, uint8_t squareY)
 }
 
 /**
-  Draws text on screen using the bitmap font stored in assets.
+  Gets one row of a font character as a 4 bit mask, the highest bit being the
+  leftmost pixel.
 */
-void SFG_drawText(
-  const char *text,
-  uint16_t x,
-  uint16_t y,
-  uint8_t size,
-  uint8_t color,
-  uint16_t maxLength,
+static inline uint8_t SFG_glyphRow(uint8_t fontIndex, uint8_t row)
+{
+#if SFG_CACHED_HUD
+  return SFG_glyphRows[fontIndex][row];
+#else
+  // the font is stored by columns
+  uint16_t character = SFG_font[fontIndex] << row;
+
+  return ((character >> 12) & 0x08) | ((character >> 9) & 0x04) |
+    ((character >> 6) & 0x02) | ((character >> 3) & 0x01);
+#endif
+}
+
+/**
+  Draws a horizontal line of game pixels, the part outside the screen is cut
+  off.
+*/
+static inline void SFG_fillGameRow(uint16_t x, uint16_t y, uint16_t length,
+  uint8_t color)
+{
+  if (x >= SFG_GAME_RESOLUTION_X || y >= SFG_GAME_RESOLUTION_Y)
+    return;
+
+  if (length > SFG_GAME_RESOLUTION_X - x)
+    length = SFG_GAME_RESOLUTION_X - x;
+
+#if SFG_CACHED_HUD
+  if (SFG_hudCache.composing)
+  {
+    if (y >= SFG_GAME_RESOLUTION_Y - SFG_HUD_BAR_HEIGHT)
+    {
+      uint8_t *pixel = SFG_hudCache.pixels + x + SFG_GAME_RESOLUTION_X *
+        (y - (SFG_GAME_RESOLUTION_Y - SFG_HUD_BAR_HEIGHT));
+
+      for (uint16_t i = 0; i < length; ++i)
+        pixel[i] = color;
+    }
+
+    return;
+  }
+#endif
+
+  for (uint16_t i = x; i < x + length; ++i)
+    SFG_setGamePixel(i,y,color);
+}
+
+/**
+  Draws text on screen using the bitmap font stored in assets.
+*/
+void SFG_drawText(
+  const char *text,
+  uint16_t x,
+  uint16_t y,
+  uint8_t size,
+  uint8_t color,
+  uint16_t maxLength,
   uint16_t limitX)
 {
   if (size == 0)
@@ -3008,40 +5237,40 @@ void SFG_drawText(
   uint16_t pos = 0;
 
   uint16_t currentX = x;
-  uint16_t currentY = y;
 
   while (pos < maxLength && text[pos] != 0) // for each character
   {
-    uint16_t character = 
-      //SFG_PROGRAM_MEMORY_U8(SFG_font + SFG_charToFontIndex(text[pos]));
-      SFG_font[SFG_charToFontIndex(text[pos])];
+    uint8_t fontIndex = SFG_charToFontIndex(text[pos]);
+
+    uint16_t currentY = y;
 
-    for (uint8_t i = 0; i < SFG_FONT_CHARACTER_SIZE; ++i) // for each line
+    for (uint8_t j = 0; j < SFG_FONT_CHARACTER_SIZE; ++j) // for each row
     {
-      currentY = y;
+      uint8_t row = SFG_glyphRow(fontIndex,j);
+      uint8_t i = 0;
 
-      for (uint8_t j = 0; j < SFG_FONT_CHARACTER_SIZE; ++j) // for each row
+      while (i < SFG_FONT_CHARACTER_SIZE) // draw the row by runs of pixels
       {
-        if (character & 0x8000)
-          for (uint8_t k = 0; k < size; ++k)
-            for (uint8_t l = 0; l < size; ++l)
-            {
-              uint16_t drawX = currentX + k;
-              uint16_t drawY = currentY + l;
+        if (!(row & (0x08 >> i)))
+        {
+          i++;
+          continue;
+        }
 
-              if (drawX < SFG_GAME_RESOLUTION_X &&
-                drawY < SFG_GAME_RESOLUTION_Y)
-                SFG_setGamePixel(drawX,drawY,color);
-            }
+        uint8_t start = i;
 
-        currentY += size;
-        character = character << 1;
+        while (i < SFG_FONT_CHARACTER_SIZE && (row & (0x08 >> i)))
+          i++;
+
+        for (uint8_t l = 0; l < size; ++l)
+          SFG_fillGameRow(currentX + start * size,currentY + l,
+            (i - start) * size,color);
       }
 
-      currentX += size;
+      currentY += size;
     }
-    
-    currentX += size; // space
+
+    currentX += (SFG_FONT_CHARACTER_SIZE + 1) * size; // + space
       
     if (currentX > limitX)
     {
@@ -4152,8 +6381,7 @@ void SFG_fillRectangle(
     return;
 
   for (uint16_t j = y; j < y + height; ++j)
-    for (uint16_t i = x; i < x + width; ++i)
-      SFG_setGamePixel(i,j,color);
+    SFG_fillGameRow(x,j,width,color);
 }
 
 static inline void SFG_clearScreen(uint8_t color)
@@ -4162,13 +6390,34 @@ static inline void SFG_clearScreen(uint8_t color)
     SFG_GAME_RESOLUTION_Y,color);
 }
 
+/**
+  Computes the color of a revealed map square on the map, not counting the
+  player.
+*/
+uint8_t SFG_mapSquareColor(int16_t x, int16_t y)
+{
+  uint8_t properties;
+
+  SFG_TileDefinition tile =
+    SFG_getMapTile(SFG_currentLevel.levelPointer,x,y,&properties);
+
+  if (properties == SFG_TILE_PROPERTY_ELEVATOR)
+    return SFG_MAP_ELEVATOR_COLOR;
+  else if (properties == SFG_TILE_PROPERTY_SQUEEZER)
+    return SFG_MAP_SQUEEZER_COLOR;
+  else if (properties == SFG_TILE_PROPERTY_DOOR)
+    return SFG_MAP_DOOR_COLOR;
+
+  uint8_t c = SFG_TILE_CEILING_HEIGHT(tile) / 4;
+
+  return c != 0 ? (SFG_TILE_FLOOR_HEIGHT(tile) % 8 + 3) * 8 + c - 1 : 0;
+}
+
 /**
   Draws fullscreen map of the current level.
 */
 void SFG_drawMap(void)
 {
-  SFG_clearScreen(0);
-   
   uint16_t maxJ =
     (SFG_MAP_PIXEL_SIZE * SFG_MAP_SIZE) < SFG_GAME_RESOLUTION_Y ?
     (SFG_MAP_SIZE) : (SFG_GAME_RESOLUTION_Y / SFG_MAP_PIXEL_SIZE);
@@ -4189,6 +6438,34 @@ void SFG_drawMap(void)
   uint8_t playerColor = 
     SFG_game.blink ? SFG_MAP_PLAYER_COLOR1 : SFG_MAP_PLAYER_COLOR2;
 
+#if SFG_CACHED_MAP
+  uint16_t newParts =
+    SFG_currentLevel.mapRevealMask & ~SFG_currentLevel.mapColorsMask;
+
+  if (newParts != 0) // compute colors of the newly revealed parts
+  {
+    for (int16_t j = 0; j < SFG_MAP_SIZE; ++j)
+      for (int16_t i = 0; i < SFG_MAP_SIZE; ++i)
+        if (newParts & SFG_getMapRevealBit(i,j))
+          SFG_currentLevel.mapColors[j * SFG_MAP_SIZE + i] =
+            SFG_mapSquareColor(i,j);
+
+    SFG_currentLevel.mapColorsMask |= newParts;
+  }
+#endif
+
+  // only clear the screen where the map doesn't draw
+
+  SFG_fillRectangle(0,0,SFG_GAME_RESOLUTION_X,topLeftY,0);
+  SFG_fillRectangle(0,topLeftY + maxJ * SFG_MAP_PIXEL_SIZE,
+    SFG_GAME_RESOLUTION_X,
+    SFG_GAME_RESOLUTION_Y - topLeftY - maxJ * SFG_MAP_PIXEL_SIZE,0);
+
+  uint8_t row[SFG_GAME_RESOLUTION_X]; // one screen row of the map
+
+  for (uint16_t i = 0; i < SFG_GAME_RESOLUTION_X; ++i)
+    row[i] = 0;
+
   for (int16_t j = 0; j < maxJ; ++j)
   {
     x = topLeftX;
@@ -4199,42 +6476,30 @@ void SFG_drawMap(void)
 
       if (SFG_currentLevel.mapRevealMask & SFG_getMapRevealBit(i,j)) 
       {
-        uint8_t properties;
-
-        SFG_TileDefinition tile =
-          SFG_getMapTile(SFG_currentLevel.levelPointer,i,j,&properties);
-
-        color = playerColor; // start with player color
-
-        if (i != SFG_player.squarePosition[0] ||
-            j != SFG_player.squarePosition[1])
-        {
-          if (properties == SFG_TILE_PROPERTY_ELEVATOR)
-            color = SFG_MAP_ELEVATOR_COLOR;
-          else if (properties == SFG_TILE_PROPERTY_SQUEEZER)
-            color = SFG_MAP_SQUEEZER_COLOR;
-          else if (properties == SFG_TILE_PROPERTY_DOOR)
-            color = SFG_MAP_DOOR_COLOR;
-          else
-          {
-            color = 0;
-
-            uint8_t c = SFG_TILE_CEILING_HEIGHT(tile) / 4;
-
-            if (c != 0)
-              color = (SFG_TILE_FLOOR_HEIGHT(tile) % 8 + 3) * 8 + c - 1;
-          }
-        }
+        if (i == SFG_player.squarePosition[0] &&
+          j == SFG_player.squarePosition[1])
+          color = playerColor;
+        else
+#if SFG_CACHED_MAP
+          color = SFG_currentLevel.mapColors[j * SFG_MAP_SIZE + i];
+#else
+          color = SFG_mapSquareColor(i,j);
+#endif
       }
 
-      for (int_fast16_t k = 0; k < SFG_MAP_PIXEL_SIZE; ++k)
-        for (int_fast16_t l = 0; l < SFG_MAP_PIXEL_SIZE; ++l)
-          SFG_setGamePixel(x + l, y + k,color);
+      for (uint16_t k = 0; k < SFG_MAP_PIXEL_SIZE; ++k)
+        row[x + k] = color;
 
       x += SFG_MAP_PIXEL_SIZE;
     }
 
-    y += SFG_MAP_PIXEL_SIZE;
+    for (uint16_t k = 0; k < SFG_MAP_PIXEL_SIZE; ++k)
+    {
+      for (uint16_t i = 0; i < SFG_GAME_RESOLUTION_X; ++i)
+        SFG_setGamePixel(i,y,row[i]);
+
+      y++;
+    }
   } 
 }
 
@@ -4472,197 +6737,735 @@ void SFG_drawMenu(void)
   SFG_blitImage(SFG_logoImage,SFG_GAME_RESOLUTION_X / 2 - 
     (SFG_TEXTURE_SIZE / 2) * SFG_FONT_SIZE_SMALL,y,SFG_FONT_SIZE_SMALL);
 
-#if SFG_GAME_RESOLUTION_Y > 50
-  y += 32 * SFG_FONT_SIZE_MEDIUM + SFG_characterSize(SFG_FONT_SIZE_MEDIUM);
-#else
-  y = 2;
+#if SFG_GAME_RESOLUTION_Y > 50
+  y += 32 * SFG_FONT_SIZE_MEDIUM + SFG_characterSize(SFG_FONT_SIZE_MEDIUM);
+#else
+  y = 2;
+#endif
+
+  uint8_t i = 0;
+
+  while (1) // draw menu items
+  {
+    uint8_t item = SFG_getMenuItem(i);
+
+    if (item == SFG_MENU_ITEM_NONE)
+      break;
+
+#if (SFG_GAME_RESOLUTION_Y < 70) || SFG_FORCE_SINGLE_ITEM_MENU
+    // with low resolution only display the selected item
+
+    if (i != SFG_game.selectedMenuItem)
+    {
+      i++;
+      continue;
+    }
+#endif
+
+    const char *text = SFG_menuItemTexts[item];
+    uint8_t textLen = SFG_textLen(text);
+
+    uint16_t drawX = (SFG_GAME_RESOLUTION_X -
+      SFG_textHorizontalSize(text,SFG_FONT_SIZE_MEDIUM)) / 2;
+
+    uint8_t textColor = 7;
+
+    if (i != SFG_game.selectedMenuItem)
+      textColor = 23;
+    else
+      SFG_fillRectangle( // menu item highlight
+        SELECTION_START_X,
+        y - SFG_FONT_SIZE_MEDIUM,
+        SFG_GAME_RESOLUTION_X - SELECTION_START_X * 2,
+        SFG_characterSize(SFG_FONT_SIZE_MEDIUM),2);
+  
+    SFG_drawText(text,drawX,y,SFG_FONT_SIZE_MEDIUM,textColor,0,0);
+
+    if ((item == SFG_MENU_ITEM_PLAY || item == SFG_MENU_ITEM_SOUND
+         || item == SFG_MENU_ITEM_SHEAR) &&
+        ((i != SFG_game.selectedMenuItem) || SFG_game.blink))
+    {
+      uint32_t x =
+        drawX + SFG_characterSize(SFG_FONT_SIZE_MEDIUM) * (textLen + 1);
+
+      uint8_t c = 93;
+
+      if (item == SFG_MENU_ITEM_PLAY)
+        SFG_drawNumber(SFG_game.selectedLevel + 1,x,y,SFG_FONT_SIZE_MEDIUM,c);
+      else if (item == SFG_MENU_ITEM_SHEAR)
+      {
+        uint8_t n = (SFG_game.settings >> 2) & 0x03;
+
+        SFG_drawNumber(n == 3 ? 2 : n,x,y,SFG_FONT_SIZE_MEDIUM,c);
+      }
+      else
+      {
+        char settingText[3] = "  ";
+
+        settingText[0] = (SFG_game.settings & 0x01) ? 'S' : ' ';
+        settingText[1] = (SFG_game.settings & 0x02) ? 'M' : ' ';
+
+        SFG_drawText(settingText,x,y,SFG_FONT_SIZE_MEDIUM,c,0,0);
+      }
+    }
+
+    y += SFG_characterSize(SFG_FONT_SIZE_MEDIUM) + SFG_FONT_SIZE_MEDIUM;
+    i++;
+  }
+  
+  SFG_drawText(SFG_VERSION_STRING " CC0",SFG_HUD_MARGIN,SFG_GAME_RESOLUTION_Y -
+    SFG_HUD_MARGIN - SFG_FONT_SIZE_SMALL * SFG_FONT_CHARACTER_SIZE,
+    SFG_FONT_SIZE_SMALL,4,0,0);
+
+  #if SFG_OS_IS_MALWARE
+    if (SFG_game.blink)
+      SFG_drawText(SFG_MALWARE_WARNING,SFG_HUD_MARGIN,SFG_HUD_MARGIN,
+        SFG_FONT_SIZE_MEDIUM,95,0,0);
+  #endif
+
+  #undef MAX_ITEMS
+  #undef BACKGROUND_SCALE
+  #undef SCROLL_PIXELS_PER_FRAME
+}
+
+void SFG_drawWinOverlay(void)
+{
+  uint32_t t = RCL_min(SFG_WIN_ANIMATION_DURATION,SFG_game.stateTime);
+
+  uint32_t t2 = RCL_min(t,SFG_WIN_ANIMATION_DURATION / 4);
+
+  #define STRIP_HEIGHT (SFG_GAME_RESOLUTION_Y / 2)
+  #define INNER_STRIP_HEIGHT ((STRIP_HEIGHT * 3) / 4)
+  #define STRIP_START ((SFG_GAME_RESOLUTION_Y - STRIP_HEIGHT) / 2)
+
+  RCL_Unit l = (t2 * STRIP_HEIGHT * 4) / SFG_WIN_ANIMATION_DURATION;
+
+  for (uint16_t y = STRIP_START; y < STRIP_START + l; ++y)
+    for (uint16_t x = 0; x < SFG_GAME_RESOLUTION_X; ++x)
+      SFG_setGamePixel(x,y, 
+        RCL_abs(y - (SFG_GAME_RESOLUTION_Y / 2)) <= (INNER_STRIP_HEIGHT / 2) ?
+          0 : 172);
+
+  char textLine[] = SFG_TEXT_LEVEL_COMPLETE;
+
+  uint16_t y = SFG_GAME_RESOLUTION_Y / 2 - 
+    ((STRIP_HEIGHT + INNER_STRIP_HEIGHT) / 2) / 2;
+
+  uint16_t x = (SFG_GAME_RESOLUTION_X - 
+    SFG_textHorizontalSize(textLine,SFG_FONT_SIZE_BIG)) / 2;
+
+  SFG_drawText(textLine,x,y,SFG_FONT_SIZE_BIG,7 + SFG_game.blink * 95,255,0);
+
+  uint32_t timeTotal = SFG_SAVE_TOTAL_TIME;
+
+  // don't show totals in level 1:
+  uint8_t blink = (SFG_game.blink) && (SFG_currentLevel.levelNumber != 0)
+    && (timeTotal != 0);
+
+  if (t >= (SFG_WIN_ANIMATION_DURATION / 2))
+  {
+    y += (SFG_FONT_SIZE_BIG + SFG_FONT_SIZE_MEDIUM) * SFG_FONT_CHARACTER_SIZE;
+    x = SFG_HUD_MARGIN;
+
+    #define CHAR_SIZE (SFG_FONT_SIZE_SMALL * SFG_FONT_CHARACTER_SIZE)
+
+    uint32_t time = blink ? timeTotal : SFG_currentLevel.completionTime10sOfS;
+
+    x += SFG_drawNumber(time / 10,x,y,SFG_FONT_SIZE_SMALL,7) *
+      CHAR_SIZE + SFG_FONT_SIZE_SMALL;
+
+    char timeRest[5] = ".X s";
+
+    timeRest[1] = '0' + (time % 10);
+    
+    SFG_drawText(timeRest,x,y,SFG_FONT_SIZE_SMALL,7,4,0);
+
+    x = SFG_HUD_MARGIN;
+    y += (SFG_FONT_SIZE_BIG + SFG_FONT_SIZE_MEDIUM) * SFG_FONT_CHARACTER_SIZE;
+
+    if (blink)
+    {
+      x += (SFG_drawNumber(SFG_game.save[10] + SFG_game.save[11] * 256,x,y,
+        SFG_FONT_SIZE_SMALL,7) + 1) * CHAR_SIZE;
+    }
+    else
+    {
+      x += SFG_drawNumber(SFG_currentLevel.monstersDead,x,y,
+        SFG_FONT_SIZE_SMALL,7) * CHAR_SIZE;
+
+      SFG_drawText("/",x,y,SFG_FONT_SIZE_SMALL,7,1,0);
+
+      x += CHAR_SIZE;
+
+      x += (SFG_drawNumber(SFG_currentLevel.monsterRecordCount,x,y,
+        SFG_FONT_SIZE_SMALL,7) + 1) * CHAR_SIZE;
+    }
+    
+    SFG_drawText(SFG_TEXT_KILLS,x,y,SFG_FONT_SIZE_SMALL,7,255,0);
+
+    if ((t >= (SFG_WIN_ANIMATION_DURATION - 1)) && 
+      (SFG_currentLevel.levelNumber != (SFG_NUMBER_OF_LEVELS - 1)) &&
+      SFG_game.blink)
+    {
+      y += (SFG_FONT_SIZE_BIG + SFG_FONT_SIZE_MEDIUM) * SFG_FONT_CHARACTER_SIZE;
+
+      SFG_drawText(SFG_TEXT_SAVE_PROMPT,
+        (SFG_GAME_RESOLUTION_X - SFG_textHorizontalSize(SFG_TEXT_SAVE_PROMPT,
+          SFG_FONT_SIZE_MEDIUM)) / 2,y,SFG_FONT_SIZE_MEDIUM,7,255,0);
+    }
+
+    #undef CHAR_SIZE
+  }
+
+  #undef STRIP_HEIGHT
+  #undef STRIP_START
+  #undef INNER_STRIP_HEIGHT
+}
+
+#if SFG_RENDER_THREADS > 1
+/**
+  Renders one vertical strip of the 3D view, to be run by SFG_runInParallel.
+*/
+void SFG_renderStrip(uint8_t part, uint8_t parts)
+{
+  int16_t columns = SFG_renderCamera().resolution.x;
+
+  RCL_renderComplexColumns(SFG_texturesAt,SFG_game.rayConstraints,
+    (part * columns) / parts,((part + 1) * columns) / parts);
+}
+#endif
+
+#if SFG_REUSE_STATIC_FRAMES
+/**
+  Range (in squares, Manhattan distance) around the camera in which the squares
+  can be seen in the 3D view, i.e. those not farther (in steps) than the ray
+  step limit.
+*/
+#if SFG_SKIP_UNIFORM_BLOCKS
+  #define SFG_VIEW_RANGE (2 * SFG_MAP_SIZE) // a ray step can cross many squares
+#else
+  #define SFG_VIEW_RANGE SFG_RAYCASTING_MAX_STEPS
+#endif
+
+/**
+  Records the moving squares (elevators and squeezers) that can be seen in the
+  3D view rendered with given camera, along with their current heights, so that
+  SFG_viewCacheMatches only has to check these. Squares out of the range of the
+  rays and those completely outside the field of view are left out.
+*/
+void SFG_recordViewMovingSquares(RCL_Camera camera)
+{
+  /* The sides of the field of view are given by the directions of the
+     leftmost and rightmost rays, the squares are tested with a margin so that
+     rays passing close to their corners are accounted for. */
+  #define MARGIN (RCL_UNITS_PER_SQUARE / 8)
+
+  RCL_Vector2D dir1 =
+    RCL_angleToDirection(camera.direction - RCL_HORIZONTAL_FOV_HALF);
+
+  RCL_Vector2D dir2 =
+    RCL_angleToDirection(camera.direction + RCL_HORIZONTAL_FOV_HALF);
+
+  int16_t squareX = RCL_divRoundDown(camera.position.x,RCL_UNITS_PER_SQUARE);
+  int16_t squareY = RCL_divRoundDown(camera.position.y,RCL_UNITS_PER_SQUARE);
+
+  SFG_viewCache.movingSquareCount = 0;
+
+  for (int16_t y = RCL_max(0,squareY - SFG_VIEW_RANGE);
+    y <= RCL_min(SFG_MAP_SIZE - 1,squareY + SFG_VIEW_RANGE); ++y)
+  {
+    int16_t rangeX = SFG_VIEW_RANGE - RCL_abs(y - squareY);
+
+    for (int16_t x = RCL_max(0,squareX - rangeX);
+      x <= RCL_min(SFG_MAP_SIZE - 1,squareX + rangeX); ++x)
+    {
+      uint8_t properties;
+
+      SFG_getMapTile(SFG_currentLevel.levelPointer,x,y,&properties);
+
+      if (properties != SFG_TILE_PROPERTY_ELEVATOR &&
+        properties != SFG_TILE_PROPERTY_SQUEEZER)
+        continue;
+
+      /* Count the corners left of the leftmost ray and right of the rightmost
+         one, the square can't be seen if all four are on one of these
+         sides. */
+      uint8_t left = 0, right = 0;
+
+      for (uint8_t i = 0; i < 4; ++i)
+      {
+        RCL_Unit cornerX = (x + (i & 0x01)) * RCL_UNITS_PER_SQUARE +
+          ((i & 0x01) ? MARGIN : -MARGIN) - camera.position.x;
+
+        RCL_Unit cornerY = (y + (i >> 1)) * RCL_UNITS_PER_SQUARE +
+          ((i >> 1) ? MARGIN : -MARGIN) - camera.position.y;
+
+        left += dir1.x * cornerY - dir1.y * cornerX > 0;
+        right += dir2.x * cornerY - dir2.y * cornerX < 0;
+      }
+
+      if (left == 4 || right == 4)
+        continue;
+
+      if (SFG_viewCache.movingSquareCount >= SFG_MAX_VIEW_MOVING_SQUARES)
+      {
+        SFG_viewCache.movingSquareCount = 255;
+        return;
+      }
+
+      SFG_viewCache.movingSquares[SFG_viewCache.movingSquareCount] =
+        y * SFG_MAP_SIZE + x;
+
+      // only one of the heights moves, so their sum changes whenever it does
+      SFG_viewCache.movingHeights[SFG_viewCache.movingSquareCount] =
+        SFG_floorHeightAt(x,y) + SFG_ceilingHeightAt(x,y);
+
+      SFG_viewCache.movingSquareCount++;
+    }
+  }
+
+  #undef MARGIN
+}
+
+/**
+  Says whether the state recorded with the kept 3D view (SFG_viewCache) is
+  still current, i.e. the camera is the same and nothing that can be seen has
+  moved since.
+*/
+uint8_t SFG_viewCacheMatches(void)
+{
+  RCL_Camera camera = SFG_renderCamera();
+  RCL_Camera *c1 = &camera, *c2 = &SFG_viewCache.camera;
+
+  if (c1->position.x != c2->position.x || c1->position.y != c2->position.y ||
+    c1->direction != c2->direction || c1->height != c2->height ||
+    c1->shear != c2->shear || c1->resolution.x != c2->resolution.x ||
+    c1->resolution.y != c2->resolution.y)
+    return 0;
+
+  int16_t squareX = RCL_divRoundDown(c1->position.x,RCL_UNITS_PER_SQUARE);
+  int16_t squareY = RCL_divRoundDown(c1->position.y,RCL_UNITS_PER_SQUARE);
+
+  for (uint8_t i = 0; i < SFG_currentLevel.doorRecordCount; ++i)
+  {
+    SFG_DoorRecord *door = &(SFG_currentLevel.doorRecords[i]);
+
+    if ((door->state & SFG_DOOR_VERTICAL_POSITION_MASK) !=
+      SFG_viewCache.doorHeights[i] &&
+      RCL_abs(door->coords[0] - squareX) + RCL_abs(door->coords[1] - squareY)
+      <= SFG_VIEW_RANGE)
+      return 0;
+  }
+
+  if (SFG_viewCache.movingSquareCount > SFG_MAX_VIEW_MOVING_SQUARES)
+    return 0;
+
+  for (uint8_t i = 0; i < SFG_viewCache.movingSquareCount; ++i)
+  {
+    int16_t x = SFG_viewCache.movingSquares[i] % SFG_MAP_SIZE;
+    int16_t y = SFG_viewCache.movingSquares[i] / SFG_MAP_SIZE;
+
+    if (SFG_floorHeightAt(x,y) + SFG_ceilingHeightAt(x,y) !=
+      SFG_viewCache.movingHeights[i])
+      return 0;
+  }
+
+  return 1;
+}
+#endif
+
+#if SFG_KEEP_VIEW
+/**
+  Draws every step-th column (starting with column offset) of the 3D view kept
+  by SFG_viewCache, the columns are those of the render camera.
+*/
+void SFG_drawCachedColumns(uint8_t step, uint8_t offset)
+{
+  int16_t columns = SFG_renderCamera().resolution.x;
+
+  for (uint16_t y = 0; y < SFG_player.camera.resolution.y; ++y)
+  {
+    const uint8_t *row = SFG_viewCache.pixels + y * SFG_GAME_RESOLUTION_X;
+
+    for (int16_t column = offset; column < columns; column += step)
+    {
+#if SFG_DYNAMIC_RESOLUTION
+      int16_t x = column * SFG_game.resolutionScaleX;
+      int16_t xEnd = RCL_min(x + SFG_game.resolutionScaleX,
+        SFG_player.camera.resolution.x);
+#else
+      int16_t x = column;
+      int16_t xEnd = column + 1;
+#endif
+
+      x *= SFG_RAYCASTING_SUBSAMPLE;
+      xEnd *= SFG_RAYCASTING_SUBSAMPLE;
+
+      for (; x < xEnd; ++x)
+        SFG_setGamePixel(x,y,row[x]);
+    }
+  }
+}
+#endif
+
+#if SFG_INTERLACED_RENDERING
+/**
+  Says whether the next frame can be rendered with only half of the columns
+  (see SFG_INTERLACED_RENDERING), i.e. the kept view is complete and the camera
+  hasn't changed too much since.
+*/
+uint8_t SFG_canInterlace(RCL_Camera camera)
+{
+  RCL_Camera *previous = &SFG_viewCache.camera;
+
+  RCL_Unit turn = RCL_wrap(camera.direction - previous->direction,
+    RCL_UNITS_PER_SQUARE);
+
+  return SFG_viewCache.complete &&
+    camera.resolution.x == previous->resolution.x &&
+    camera.resolution.y == previous->resolution.y &&
+    RCL_min(turn,RCL_UNITS_PER_SQUARE - turn) <=
+      SFG_INTERLACED_MAX_TURN_UNITS_PER_FRAME &&
+    RCL_abs(camera.position.x - previous->position.x) +
+      RCL_abs(camera.position.y - previous->position.y) <=
+      SFG_INTERLACED_MAX_MOVE_UNITS_PER_FRAME;
+}
+#endif
+
+/**
+  Renders the 3D view of the level, without sprites.
+*/
+void SFG_drawWorld(void)
+{
+  RCL_Camera camera = SFG_renderCamera();
+
+#if SFG_SQUARE_GRID
+  SFG_updateSquareGrid();
+#endif
+
+#if SFG_ADAPTIVE_RAY_BUDGETS
+  SFG_updateRayBudgets(0);
+#endif
+
+#if SFG_PRESCALED_BACKGROUND
+  for (int16_t i = 0; i < camera.resolution.x; ++i)
+  {
+  #if SFG_DYNAMIC_RESOLUTION
+    int16_t x = i * SFG_game.resolutionScaleX;
+  #else
+    int16_t x = i;
+  #endif
+
+    SFG_game.backgroundColumns[i] = SFG_decodedImages.background +
+      SFG_game.backgroundScaleMap[(x * SFG_RAYCASTING_SUBSAMPLE +
+      SFG_game.backgroundScroll) % SFG_GAME_RESOLUTION_Y] * SFG_TEXTURE_SIZE;
+  }
+#endif
+
+#if SFG_MIPMAPS
+  /* level L + 1 is used where a wall square gets smaller on screen than the
+     texture size of level L */
+  for (uint8_t i = 0; i < SFG_MIPMAP_LEVELS - 1; ++i)
+    SFG_game.mipmapDistances[i] = (RCL_perspectiveScaleVerticalInverse(
+      camera.resolution.y,SFG_TEXTURE_SIZE >> i) *
+      SFG_MIPMAP_DISTANCE_PERCENT) / 100;
 #endif
 
-  uint8_t i = 0;
+#if SFG_INTERLACED_RENDERING
+  uint8_t interlace = SFG_canInterlace(camera);
 
-  while (1) // draw menu items
-  {
-    uint8_t item = SFG_getMenuItem(i);
+#if SFG_REUSE_STATIC_FRAMES
+  /* if the other half was rendered in the same state, the view will be whole
+     after this frame */
+  uint8_t otherHalfMatches = interlace && SFG_viewCacheMatches();
+#endif
 
-    if (item == SFG_MENU_ITEM_NONE)
-      break;
+  if (interlace)
+  {
+    SFG_viewCache.interlaceOffset = !SFG_viewCache.interlaceOffset;
+    RCL_setColumnStep(2,SFG_viewCache.interlaceOffset);
+  }
+#endif
 
-#if (SFG_GAME_RESOLUTION_Y < 70) || SFG_FORCE_SINGLE_ITEM_MENU
-    // with low resolution only display the selected item
+#if SFG_RENDER_THREADS > 1
+  RCL_renderComplexBegin(
+    camera,
+    SFG_floorHeightAt,
+    SFG_ceilingHeightAt);
 
-    if (i != SFG_game.selectedMenuItem)
-    {
-      i++;
-      continue;
-    }
+  SFG_runInParallel(SFG_renderStrip);
+#else
+  RCL_renderComplex(
+    camera,
+    SFG_floorHeightAt,
+    SFG_ceilingHeightAt,
+    SFG_texturesAt,
+    SFG_game.rayConstraints);
 #endif
 
-    const char *text = SFG_menuItemTexts[item];
-    uint8_t textLen = SFG_textLen(text);
+#if SFG_INTERLACED_RENDERING
+  if (interlace)
+  {
+    RCL_setColumnStep(1,0);
+    SFG_drawCachedColumns(2,!SFG_viewCache.interlaceOffset);
+  }
+#endif
 
-    uint16_t drawX = (SFG_GAME_RESOLUTION_X -
-      SFG_textHorizontalSize(text,SFG_FONT_SIZE_MEDIUM)) / 2;
+#if SFG_FULL_Z_BUFFER
+#if SFG_RENDER_THREADS > 1
+  SFG_runInParallel(SFG_updateDepthTiles);
+#else
+  SFG_updateDepthTiles(0,1);
+#endif
+#endif
 
-    uint8_t textColor = 7;
+#if SFG_VIEW_SPRITE_VISIBILITY
+  /* with interlacing half of the columns have depths from a different view,
+     so they aren't used */
+#if SFG_INTERLACED_RENDERING
+  SFG_game.viewColumns = interlace ? 0 : camera.resolution.x;
+#else
+  SFG_game.viewColumns = camera.resolution.x;
+#endif
+#endif
 
-    if (i != SFG_game.selectedMenuItem)
-      textColor = 23;
-    else
-      SFG_fillRectangle( // menu item highlight
-        SELECTION_START_X,
-        y - SFG_FONT_SIZE_MEDIUM,
-        SFG_GAME_RESOLUTION_X - SELECTION_START_X * 2,
-        SFG_characterSize(SFG_FONT_SIZE_MEDIUM),2);
-  
-    SFG_drawText(text,drawX,y,SFG_FONT_SIZE_MEDIUM,textColor,0,0);
+#if SFG_KEEP_VIEW
+  // the view has been recorded by SFG_setWorldPixel, now record its state
 
-    if ((item == SFG_MENU_ITEM_PLAY || item == SFG_MENU_ITEM_SOUND
-         || item == SFG_MENU_ITEM_SHEAR) &&
-        ((i != SFG_game.selectedMenuItem) || SFG_game.blink))
-    {
-      uint32_t x =
-        drawX + SFG_characterSize(SFG_FONT_SIZE_MEDIUM) * (textLen + 1);
+  SFG_viewCache.complete = 1;
+  SFG_viewCache.camera = camera;
+#endif
 
-      uint8_t c = 93;
+#if SFG_REUSE_STATIC_FRAMES
+#if SFG_INTERLACED_RENDERING
+  SFG_viewCache.valid = interlace ? otherHalfMatches : 1;
+#else
+  SFG_viewCache.valid = 1;
+#endif
 
-      if (item == SFG_MENU_ITEM_PLAY)
-        SFG_drawNumber(SFG_game.selectedLevel + 1,x,y,SFG_FONT_SIZE_MEDIUM,c);
-      else if (item == SFG_MENU_ITEM_SHEAR)
-      {
-        uint8_t n = (SFG_game.settings >> 2) & 0x03;
+  for (uint8_t i = 0; i < SFG_currentLevel.doorRecordCount; ++i)
+    SFG_viewCache.doorHeights[i] = SFG_currentLevel.doorRecords[i].state &
+      SFG_DOOR_VERTICAL_POSITION_MASK;
 
-        SFG_drawNumber(n == 3 ? 2 : n,x,y,SFG_FONT_SIZE_MEDIUM,c);
-      }
-      else
-      {
-        char settingText[3] = "  ";
+  SFG_recordViewMovingSquares(camera);
+#endif
+}
 
-        settingText[0] = (SFG_game.settings & 0x01) ? 'S' : ' ';
-        settingText[1] = (SFG_game.settings & 0x02) ? 'M' : ' ';
+/**
+  Gets a bit mask of the access cards shown in the HUD (blinking ones only
+  when the blink is on).
+*/
+static inline uint8_t SFG_hudCards(void)
+{
+  return (SFG_player.cards | ((SFG_player.cards >> 3) *
+    (SFG_game.blink & 0x01))) & 0x07;
+}
 
-        SFG_drawText(settingText,x,y,SFG_FONT_SIZE_MEDIUM,c,0,0);
-      }
-    }
+/**
+  Draws the HUD bar at the bottom of the screen.
+*/
+void SFG_drawHudBar(void)
+{
+  uint8_t color = 61;
+  uint8_t color2 = 48;
 
-    y += SFG_characterSize(SFG_FONT_SIZE_MEDIUM) + SFG_FONT_SIZE_MEDIUM;
-    i++;
+  if (SFG_game.cheatState & 0x80)
+  {
+    color = 170;
+    color2 = 0;
   }
-  
-  SFG_drawText(SFG_VERSION_STRING " CC0",SFG_HUD_MARGIN,SFG_GAME_RESOLUTION_Y -
-    SFG_HUD_MARGIN - SFG_FONT_SIZE_SMALL * SFG_FONT_CHARACTER_SIZE,
-    SFG_FONT_SIZE_SMALL,4,0,0);
 
-  #if SFG_OS_IS_MALWARE
-    if (SFG_game.blink)
-      SFG_drawText(SFG_MALWARE_WARNING,SFG_HUD_MARGIN,SFG_HUD_MARGIN,
-        SFG_FONT_SIZE_MEDIUM,95,0,0);
-  #endif
+  for (uint16_t j = SFG_GAME_RESOLUTION_Y - SFG_HUD_BAR_HEIGHT;
+    j < SFG_GAME_RESOLUTION_Y; ++j)
+  {
+    SFG_fillGameRow(0,j,SFG_GAME_RESOLUTION_X,color);
 
-  #undef MAX_ITEMS
-  #undef BACKGROUND_SCALE
-  #undef SCROLL_PIXELS_PER_FRAME
+    color = color2;
+  }
+
+  #define TEXT_Y (SFG_GAME_RESOLUTION_Y - SFG_HUD_MARGIN - \
+    SFG_FONT_CHARACTER_SIZE * SFG_FONT_SIZE_MEDIUM)
+
+  SFG_drawNumber( // health
+    SFG_player.health,
+    SFG_HUD_MARGIN,
+    TEXT_Y,
+    SFG_FONT_SIZE_MEDIUM,
+    SFG_player.health > SFG_PLAYER_HEALTH_WARNING_LEVEL ? 6 : 175);
+
+  SFG_drawNumber( // ammo
+    SFG_player.weapon != SFG_WEAPON_KNIFE ?
+      SFG_player.ammo[SFG_weaponAmmo(SFG_player.weapon)] : 0,
+    SFG_GAME_RESOLUTION_X - SFG_HUD_MARGIN -
+      (SFG_FONT_CHARACTER_SIZE + 1) * SFG_FONT_SIZE_MEDIUM * 3,
+    TEXT_Y,
+    SFG_FONT_SIZE_MEDIUM,
+    6); 
+
+  uint8_t cards = SFG_hudCards();
+
+  for (uint8_t i = 0; i < 3; ++i) // access cards
+    if ((cards >> i) & 0x01)
+      SFG_fillRectangle(
+        SFG_HUD_MARGIN + (SFG_FONT_CHARACTER_SIZE + 1) *
+          SFG_FONT_SIZE_MEDIUM * (5 + i),
+        TEXT_Y,
+        SFG_FONT_SIZE_MEDIUM * SFG_FONT_CHARACTER_SIZE,
+        SFG_FONT_SIZE_MEDIUM * SFG_FONT_CHARACTER_SIZE,
+        i == 0 ? 93 : (i == 1 ? 124 : 60));
+
+  #undef TEXT_Y
 }
 
-void SFG_drawWinOverlay(void)
+#if SFG_CACHED_HUD
+/**
+  Packs everything the HUD bar shows into a single value so that it can be
+  checked whether the bar needs to be drawn again.
+*/
+static inline uint32_t SFG_hudKey(void)
 {
-  uint32_t t = RCL_min(SFG_WIN_ANIMATION_DURATION,SFG_game.stateTime);
-
-  uint32_t t2 = RCL_min(t,SFG_WIN_ANIMATION_DURATION / 4);
+  return
+    SFG_player.health |
+    ((uint32_t) (SFG_player.weapon != SFG_WEAPON_KNIFE ?
+      SFG_player.ammo[SFG_weaponAmmo(SFG_player.weapon)] : 0) << 8) |
+    ((uint32_t) SFG_hudCards() << 16) |
+    ((uint32_t) (SFG_game.cheatState >> 7) << 19);
+}
 
-  #define STRIP_HEIGHT (SFG_GAME_RESOLUTION_Y / 2)
-  #define INNER_STRIP_HEIGHT ((STRIP_HEIGHT * 3) / 4)
-  #define STRIP_START ((SFG_GAME_RESOLUTION_Y - STRIP_HEIGHT) / 2)
+/**
+  Copies the cached HUD bar picture to the screen.
+*/
+void SFG_blitHudBar(void)
+{
+  const uint8_t *pixel = SFG_hudCache.pixels;
 
-  RCL_Unit l = (t2 * STRIP_HEIGHT * 4) / SFG_WIN_ANIMATION_DURATION;
+  for (uint16_t y = SFG_GAME_RESOLUTION_Y - SFG_HUD_BAR_HEIGHT;
+    y < SFG_GAME_RESOLUTION_Y; ++y)
+  {
+#if SFG_UPSCALE != 0
+    uint8_t *row = SFG_gameScreen + y * SFG_GAME_RESOLUTION_X;
 
-  for (uint16_t y = STRIP_START; y < STRIP_START + l; ++y)
     for (uint16_t x = 0; x < SFG_GAME_RESOLUTION_X; ++x)
-      SFG_setGamePixel(x,y, 
-        RCL_abs(y - (SFG_GAME_RESOLUTION_Y / 2)) <= (INNER_STRIP_HEIGHT / 2) ?
-          0 : 172);
-
-  char textLine[] = SFG_TEXT_LEVEL_COMPLETE;
-
-  uint16_t y = SFG_GAME_RESOLUTION_Y / 2 - 
-    ((STRIP_HEIGHT + INNER_STRIP_HEIGHT) / 2) / 2;
-
-  uint16_t x = (SFG_GAME_RESOLUTION_X - 
-    SFG_textHorizontalSize(textLine,SFG_FONT_SIZE_BIG)) / 2;
+      row[x] = pixel[x];
+#else
+    for (uint16_t x = 0; x < SFG_GAME_RESOLUTION_X; ++x)
+      SFG_setGamePixel(x,y,pixel[x]);
+#endif
 
-  SFG_drawText(textLine,x,y,SFG_FONT_SIZE_BIG,7 + SFG_game.blink * 95,255,0);
+    pixel += SFG_GAME_RESOLUTION_X;
+  }
+}
+#endif
 
-  uint32_t timeTotal = SFG_SAVE_TOTAL_TIME;
+#if SFG_BATCHED_SPRITES
+/**
+  Positions of all sprites of the current frame gathered into separate arrays
+  so that they can be projected and culled together, see SFG_BATCHED_SPRITES.
+*/
+struct
+{
+  RCL_Unit positionsX[SFG_MAX_SPRITES];
+  RCL_Unit positionsY[SFG_MAX_SPRITES];
+  RCL_Unit heights[SFG_MAX_SPRITES];
+  RCL_Unit depths[SFG_MAX_SPRITES];
+  RCL_Unit screenX[SFG_MAX_SPRITES];
+  RCL_Unit screenY[SFG_MAX_SPRITES];
+  int16_t sizes[SFG_MAX_SPRITES]; ///< Sizes in pixels at distance 1.
+  const uint8_t *images[SFG_MAX_SPRITES];
+  uint8_t count;
+} SFG_spriteBatch;
+#endif
 
-  // don't show totals in level 1:
-  uint8_t blink = (SFG_game.blink) && (SFG_currentLevel.levelNumber != 0)
-    && (timeTotal != 0);
+/**
+  Adds a sprite of the 3D view given by its world position and size in pixels
+  (at distance 1). It's projected to the screen, checked for visibility and
+  then drawn, or with SFG_BATCHED_SPRITES only stored for SFG_drawSpriteBatch.
+*/
+static inline void SFG_addSprite(const uint8_t *image, RCL_Vector2D position,
+  RCL_Unit height, int16_t size)
+{
+#if SFG_BATCHED_SPRITES
+  uint8_t i = SFG_spriteBatch.count;
 
-  if (t >= (SFG_WIN_ANIMATION_DURATION / 2))
-  {
-    y += (SFG_FONT_SIZE_BIG + SFG_FONT_SIZE_MEDIUM) * SFG_FONT_CHARACTER_SIZE;
-    x = SFG_HUD_MARGIN;
+  if (i >= SFG_MAX_SPRITES)
+    return;
 
-    #define CHAR_SIZE (SFG_FONT_SIZE_SMALL * SFG_FONT_CHARACTER_SIZE)
+  SFG_spriteBatch.positionsX[i] = position.x;
+  SFG_spriteBatch.positionsY[i] = position.y;
+  SFG_spriteBatch.heights[i] = height;
+  SFG_spriteBatch.sizes[i] = size;
+  SFG_spriteBatch.images[i] = image;
+  SFG_spriteBatch.count++;
+#else
+  RCL_PixelInfo p = RCL_mapToScreen(position,height,SFG_player.camera);
 
-    uint32_t time = blink ? timeTotal : SFG_currentLevel.completionTime10sOfS;
+  if (p.depth <= 0)
+    return;
 
-    x += SFG_drawNumber(time / 10,x,y,SFG_FONT_SIZE_SMALL,7) *
-      CHAR_SIZE + SFG_FONT_SIZE_SMALL;
+  RCL_Unit x = p.position.x * SFG_RAYCASTING_SUBSAMPLE;
+  RCL_Unit scaledSize = RCL_perspectiveScaleVertical(size,p.depth);
 
-    char timeRest[5] = ".X s";
+  if (SFG_spriteIsVisibleInView(position,height,x,scaledSize,p.depth))
+    SFG_submitSprite(image,x,p.position.y,scaledSize,
+      SFG_fogValueDiminish(p.depth),p.depth);
+#endif
+}
 
-    timeRest[1] = '0' + (time % 10);
-    
-    SFG_drawText(timeRest,x,y,SFG_FONT_SIZE_SMALL,7,4,0);
+#if SFG_BATCHED_SPRITES
+/**
+  Projects all sprites added by SFG_addSprite at once, throws away those that
+  are behind the camera or out of the screen and only for the rest checks the
+  visibility (which casts a ray) and draws them. Empties the batch.
+*/
+void SFG_drawSpriteBatch(void)
+{
+  RCL_mapToScreenMany(
+    SFG_spriteBatch.positionsX,
+    SFG_spriteBatch.positionsY,
+    SFG_spriteBatch.heights,
+    SFG_spriteBatch.count,
+    SFG_player.camera,
+    SFG_spriteBatch.depths,
+    SFG_spriteBatch.screenX,
+    SFG_spriteBatch.screenY);
+
+  for (uint8_t i = 0; i < SFG_spriteBatch.count; ++i)
+  {
+    RCL_Unit depth = SFG_spriteBatch.depths[i];
 
-    x = SFG_HUD_MARGIN;
-    y += (SFG_FONT_SIZE_BIG + SFG_FONT_SIZE_MEDIUM) * SFG_FONT_CHARACTER_SIZE;
+    if (depth <= 0)
+      continue;
 
-    if (blink)
-    {
-      x += (SFG_drawNumber(SFG_game.save[10] + SFG_game.save[11] * 256,x,y,
-        SFG_FONT_SIZE_SMALL,7) + 1) * CHAR_SIZE;
-    }
-    else
-    {
-      x += SFG_drawNumber(SFG_currentLevel.monstersDead,x,y,
-        SFG_FONT_SIZE_SMALL,7) * CHAR_SIZE;
+    RCL_Unit size =
+      RCL_perspectiveScaleVertical(SFG_spriteBatch.sizes[i],depth);
 
-      SFG_drawText("/",x,y,SFG_FONT_SIZE_SMALL,7,1,0);
+    RCL_Unit x = SFG_spriteBatch.screenX[i] * SFG_RAYCASTING_SUBSAMPLE;
+    RCL_Unit y = SFG_spriteBatch.screenY[i];
 
-      x += CHAR_SIZE;
+    // the size bounds the sprite from all sides, even when it gets clamped
 
-      x += (SFG_drawNumber(SFG_currentLevel.monsterRecordCount,x,y,
-        SFG_FONT_SIZE_SMALL,7) + 1) * CHAR_SIZE;
-    }
-    
-    SFG_drawText(SFG_TEXT_KILLS,x,y,SFG_FONT_SIZE_SMALL,7,255,0);
+    if (size == 0 ||
+      x + size < 0 || x - size >= SFG_GAME_RESOLUTION_X ||
+      y + size < 0 || y - size >= SFG_GAME_RESOLUTION_Y)
+      continue;
 
-    if ((t >= (SFG_WIN_ANIMATION_DURATION - 1)) && 
-      (SFG_currentLevel.levelNumber != (SFG_NUMBER_OF_LEVELS - 1)) &&
-      SFG_game.blink)
-    {
-      y += (SFG_FONT_SIZE_BIG + SFG_FONT_SIZE_MEDIUM) * SFG_FONT_CHARACTER_SIZE;
+    RCL_Vector2D position;
 
-      SFG_drawText(SFG_TEXT_SAVE_PROMPT,
-        (SFG_GAME_RESOLUTION_X - SFG_textHorizontalSize(SFG_TEXT_SAVE_PROMPT,
-          SFG_FONT_SIZE_MEDIUM)) / 2,y,SFG_FONT_SIZE_MEDIUM,7,255,0);
-    }
+    position.x = SFG_spriteBatch.positionsX[i];
+    position.y = SFG_spriteBatch.positionsY[i];
 
-    #undef CHAR_SIZE
+    if (SFG_spriteIsVisibleInView(position,SFG_spriteBatch.heights[i],x,size,
+      depth))
+      SFG_submitSprite(SFG_spriteBatch.images[i],x,y,size,
+        SFG_fogValueDiminish(depth),depth);
   }
 
-  #undef STRIP_HEIGHT
-  #undef STRIP_START
-  #undef INNER_STRIP_HEIGHT
+  SFG_spriteBatch.count = 0;
 }
+#endif
 
 void SFG_draw(void)
 {
-#if SFG_BACKGROUND_BLUR != 0
-  SFG_backgroundBlurIndex = 0;
-#endif
-
   if (SFG_game.state == SFG_GAME_STATE_MENU)
   {
     SFG_drawMenu();
@@ -4723,12 +7526,12 @@ void SFG_draw(void)
     SFG_player.camera.height += headBobOffset;
 #endif // headbob enabled?
 
-    RCL_renderComplex(
-      SFG_player.camera,
-      SFG_floorHeightAt,
-      SFG_ceilingHeightAt,
-      SFG_texturesAt,
-      SFG_game.rayConstraints);
+#if SFG_REUSE_STATIC_FRAMES
+    if (SFG_viewCache.valid && SFG_viewCacheMatches())
+      SFG_drawCachedColumns(1,0);
+    else
+#endif
+    SFG_drawWorld();
  
     // draw sprites:
 
@@ -4754,26 +7557,12 @@ void SFG_draw(void)
             SFG_MONSTER_COORD_TO_SQUARES(m.coords[1]))
             + SFG_SPRITE_SIZE_TO_HEIGHT_ABOVE_GROUND(spriteSize);
 
-        RCL_PixelInfo p =
-          RCL_mapToScreen(worldPosition,worldHeight,SFG_player.camera);
-
-        if (p.depth > 0 &&
-          SFG_spriteIsVisible(worldPosition,worldHeight))
-        {
-          const uint8_t *s =
-            SFG_getMonsterSprite(
-              SFG_MR_TYPE(m),
-              state,
-              SFG_game.spriteAnimationFrame & 0x01);
-
-          SFG_drawScaledSprite(s,
-            p.position.x * SFG_RAYCASTING_SUBSAMPLE,p.position.y,
-            RCL_perspectiveScaleVertical(
-            SFG_SPRITE_SIZE_PIXELS(spriteSize),
-            p.depth),
-            SFG_fogValueDiminish(p.depth),
-            p.depth);
-        }
+        SFG_addSprite(
+          SFG_getMonsterSprite(
+            SFG_MR_TYPE(m),
+            state,
+            SFG_game.spriteAnimationFrame & 0x01),
+          worldPosition,worldHeight,SFG_SPRITE_SIZE_PIXELS(spriteSize));
       }
     }
 
@@ -4803,16 +7592,8 @@ void SFG_draw(void)
           RCL_Unit worldHeight = SFG_floorHeightAt(e.coords[0],e.coords[1])
             + SFG_SPRITE_SIZE_TO_HEIGHT_ABOVE_GROUND(spriteSize);
 
-          RCL_PixelInfo p =
-            RCL_mapToScreen(worldPosition,worldHeight,SFG_player.camera);
-
-          if (p.depth > 0 &&
-            SFG_spriteIsVisible(worldPosition,worldHeight))
-            SFG_drawScaledSprite(sprite,p.position.x * SFG_RAYCASTING_SUBSAMPLE,
-              p.position.y,
-              RCL_perspectiveScaleVertical(SFG_SPRITE_SIZE_PIXELS(spriteSize),
-              p.depth),
-              SFG_fogValueDiminish(p.depth),p.depth);
+          SFG_addSprite(sprite,worldPosition,worldHeight,
+            SFG_SPRITE_SIZE_PIXELS(spriteSize));
         }
       }
 
@@ -4829,9 +7610,6 @@ void SFG_draw(void)
       worldPosition.x = proj->position[0];
       worldPosition.y = proj->position[1];
 
-      RCL_PixelInfo p =
-        RCL_mapToScreen(worldPosition,proj->position[2],SFG_player.camera);
-       
       const uint8_t *s =
         SFG_effectSprites + proj->type * SFG_TEXTURE_STORE_SIZE;
 
@@ -4853,15 +7631,17 @@ void SFG_draw(void)
           ) / RCL_UNITS_PER_SQUARE;
       }
 
-      if (p.depth > 0 && 
-        SFG_spriteIsVisible(worldPosition,proj->position[2]))
-        SFG_drawScaledSprite(s,
-            p.position.x * SFG_RAYCASTING_SUBSAMPLE,p.position.y,
-            RCL_perspectiveScaleVertical(spriteSize,p.depth),
-            SFG_fogValueDiminish(p.depth),
-            p.depth);  
+      SFG_addSprite(s,worldPosition,proj->position[2],spriteSize);
     }
 
+#if SFG_BATCHED_SPRITES
+    SFG_drawSpriteBatch();
+#endif
+
+#if SFG_SORTED_SPRITES
+    SFG_drawSpriteQueue();
+#endif
+
 #if SFG_HEADBOB_ENABLED
     // after rendering sprites subtract back the head bob offset
     SFG_player.camera.height -= headBobOffset;
@@ -4878,58 +7658,23 @@ void SFG_draw(void)
 
     // draw HUD:
 
-    // bar
+#if SFG_CACHED_HUD
+    uint32_t hudKey = SFG_hudKey();
 
-    uint8_t color = 61;
-    uint8_t color2 = 48;
-
-    if (SFG_game.cheatState & 0x80)
-    {
-      color = 170;
-      color2 = 0;
-    }
-
-    for (uint16_t j = SFG_GAME_RESOLUTION_Y - SFG_HUD_BAR_HEIGHT;
-      j < SFG_GAME_RESOLUTION_Y; ++j)
+    if (!SFG_hudCache.valid || SFG_hudCache.key != hudKey)
     {
-      for (uint16_t i = 0; i < SFG_GAME_RESOLUTION_X; ++i)
-        SFG_setGamePixel(i,j,color);
+      SFG_hudCache.composing = 1;
+      SFG_drawHudBar();
+      SFG_hudCache.composing = 0;
 
-      color = color2;
+      SFG_hudCache.key = hudKey;
+      SFG_hudCache.valid = 1;
     }
 
-    #define TEXT_Y (SFG_GAME_RESOLUTION_Y - SFG_HUD_MARGIN - \
-      SFG_FONT_CHARACTER_SIZE * SFG_FONT_SIZE_MEDIUM)
-
-    SFG_drawNumber( // health
-      SFG_player.health,
-      SFG_HUD_MARGIN,
-      TEXT_Y,
-      SFG_FONT_SIZE_MEDIUM,
-      SFG_player.health > SFG_PLAYER_HEALTH_WARNING_LEVEL ? 6 : 175);
-
-    SFG_drawNumber( // ammo
-      SFG_player.weapon != SFG_WEAPON_KNIFE ?
-        SFG_player.ammo[SFG_weaponAmmo(SFG_player.weapon)] : 0,
-      SFG_GAME_RESOLUTION_X - SFG_HUD_MARGIN -
-        (SFG_FONT_CHARACTER_SIZE + 1) * SFG_FONT_SIZE_MEDIUM * 3,
-      TEXT_Y,
-      SFG_FONT_SIZE_MEDIUM,
-      6); 
-
-    for (uint8_t i = 0; i < 3; ++i) // access cards
-      if ( 
-        ((SFG_player.cards >> i) | ((SFG_player.cards >> (i + 3))
-        & SFG_game.blink)) & 0x01)
-        SFG_fillRectangle(
-          SFG_HUD_MARGIN + (SFG_FONT_CHARACTER_SIZE + 1) *
-            SFG_FONT_SIZE_MEDIUM * (5 + i),
-          TEXT_Y,
-          SFG_FONT_SIZE_MEDIUM * SFG_FONT_CHARACTER_SIZE,
-          SFG_FONT_SIZE_MEDIUM * SFG_FONT_CHARACTER_SIZE,
-          i == 0 ? 93 : (i == 1 ? 124 : 60));
-
-    #undef TEXT_Y
+    SFG_blitHudBar();
+#else
+    SFG_drawHudBar();
+#endif
 
     // border indicator
 
@@ -4950,6 +7695,64 @@ void SFG_draw(void)
   }
 }
 
+#if SFG_DYNAMIC_RESOLUTION
+/**
+  Adjusts the resolution of the 3D view (see SFG_DYNAMIC_RESOLUTION) according
+  to the CPU load of the last frame, in % of the frame time. The load is
+  averaged over several frames, then the resolution is lowered one step if it's
+  above SFG_DYNAMIC_RESOLUTION_LOAD_HIGH or raised one step if it's below
+  SFG_DYNAMIC_RESOLUTION_LOAD_LOW. The horizontal and vertical scale take turns.
+*/
+void SFG_updateDynamicResolution(uint32_t load)
+{
+  SFG_game.loadSum += load;
+  SFG_game.loadFrames++;
+
+  if (SFG_game.loadFrames < SFG_DYNAMIC_RESOLUTION_PERIOD_FRAMES)
+    return;
+
+  load = SFG_game.loadSum / SFG_game.loadFrames;
+
+  SFG_game.loadSum = 0;
+  SFG_game.loadFrames = 0;
+
+  uint8_t x = SFG_game.resolutionScaleX;
+  uint8_t y = SFG_game.resolutionScaleY;
+
+  if (load > SFG_DYNAMIC_RESOLUTION_LOAD_HIGH)
+  {
+    if (x < SFG_DYNAMIC_RESOLUTION_MAX_X &&
+      (x <= y || y >= SFG_DYNAMIC_RESOLUTION_MAX_Y))
+      x++;
+    else if (y < SFG_DYNAMIC_RESOLUTION_MAX_Y)
+      y++;
+  }
+  else if (load < SFG_DYNAMIC_RESOLUTION_LOAD_LOW)
+  {
+    if (y > 1 && (y >= x || x <= 1))
+      y--;
+    else if (x > 1)
+      x--;
+  }
+
+  if (x != SFG_game.resolutionScaleX || y != SFG_game.resolutionScaleY)
+  {
+    SFG_LOG("changing resolution of the 3D view");
+
+    SFG_game.resolutionScaleX = x;
+    SFG_game.resolutionScaleY = y;
+
+#if SFG_ADAPTIVE_RAY_BUDGETS
+    SFG_updateRayBudgets(1); // the columns are different now
+#endif
+
+#if SFG_VIEW_SPRITE_VISIBILITY
+    SFG_game.viewColumns = 0;
+#endif
+  }
+}
+#endif
+
 uint8_t SFG_mainLoopBody(void)
 {
   /* Standard deterministic game loop, independed of actual achieved FPS.
@@ -5001,6 +7804,23 @@ uint8_t SFG_mainLoopBody(void)
       // render only once
       SFG_draw();
 
+#if SFG_POST_PROCESS
+      SFG_postProcessFrame();
+#endif
+
+#if SFG_UPSCALE != 0
+  #if SFG_RENDER_THREADS > 1
+      SFG_runInParallel(SFG_upscaleRows);
+  #else
+      SFG_upscaleRows(0,1);
+  #endif
+#endif
+
+#if SFG_DYNAMIC_RESOLUTION
+      SFG_updateDynamicResolution(
+        ((SFG_getTimeMs() - timeNow) * 100) / SFG_MS_PER_FRAME);
+#endif
+
       if (SFG_game.frame % 16 == 0)
         SFG_CPU_LOAD(((SFG_getTimeMs() - timeNow) * 100) / SFG_MS_PER_FRAME);
     }
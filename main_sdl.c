@@ -36,6 +36,8 @@
 // #define GAME_LQ
 
 #ifndef __EMSCRIPTEN__
+  #define SFG_QUALITY_PRESETS 1 // for the -q flag
+
   #ifndef GAME_LQ
     // higher quality
     #define SFG_FPS 60
@@ -81,6 +83,11 @@
 */
 #define SFG_PLAYER_DAMAGE_MULTIPLIER 1024
 
+/*
+  Draw right into the RGB565 texture data, see SFG_FRAMEBUFFER.
+*/
+#define SFG_FRAMEBUFFER 2
+
 #define SDL_MUSIC_VOLUME 16
 
 #define SDL_ANALOG_DIVIDER 1024
@@ -114,11 +121,6 @@ SDL_Texture *texture;
 
 // now implement the Anarch API functions (SFG_*)
 
-void SFG_setPixel(uint16_t x, uint16_t y, uint8_t colorIndex)
-{
-  sdlScreen[y * SFG_SCREEN_RESOLUTION_X + x] = paletteRGB565[colorIndex];
-}
-
 uint32_t SFG_getTimeMs(void)
 {
   return SDL_GetTicks();
@@ -422,6 +424,9 @@ int main(int argc, char *argv[])
   uint8_t argHelp = 0;
   uint8_t argForceWindow = 0;
   uint8_t argForceFullscreen = 0;
+#if SFG_QUALITY_PRESETS
+  uint8_t argQuality = SFG_DEFAULT_QUALITY;
+#endif
 
 #ifndef __EMSCRIPTEN__
   argForceFullscreen = 1;
@@ -438,6 +443,11 @@ int main(int argc, char *argv[])
       argForceWindow = 1;
     else if (argv[i][0] == '-' && argv[i][1] == 'f' && argv[i][2] == 0)       
       argForceFullscreen = 1;
+#if SFG_QUALITY_PRESETS
+    else if (argv[i][0] == '-' && argv[i][1] == 'q' && argv[i][2] >= '0' &&
+      argv[i][2] < '0' + SFG_QUALITY_PRESET_COUNT && argv[i][3] == 0)
+      argQuality = argv[i][2] - '0';
+#endif
     else
       puts("SDL: unknown argument"); 
   }
@@ -452,7 +462,12 @@ int main(int argc, char *argv[])
     puts("CLI flags:\n");
     puts("-h   print this help and exit");
     puts("-w   force window");
+#if SFG_QUALITY_PRESETS
+    puts("-f   force fullscreen");
+    puts("-qN  set quality to N: 0 (low), 1 (medium), 2 (high)\n");
+#else
     puts("-f   force fullscreen\n");
+#endif
     puts("controls:\n");
     puts("- arrows, numpad, [W] [S] [A] [D] [Q] [E]: movement");
     puts("- mouse: rotation, [LMB] shoot, [RMB] toggle free look");
@@ -468,8 +483,13 @@ int main(int argc, char *argv[])
     return 0;
   }
 
+  SFG_setFramebuffer(sdlScreen,SFG_SCREEN_RESOLUTION_X);
   SFG_init();
 
+#if SFG_QUALITY_PRESETS
+  SFG_setQuality(argQuality);
+#endif
+
   puts("SDL: initializing SDL");
 
 #ifdef __EMSCRIPTEN__
@@ -29,6 +29,21 @@
 #include "game.h"
 #include "sounds.h"
 
+#ifndef TEST_RENDER_EXACT
+  /* Says whether the build only uses settings which mustn't change the rendered
+     image (e.g. SFG_RENDER_THREADS), it is then checked to be the same as that
+     of the default build. See the "tests" target of make.sh. */
+  #define TEST_RENDER_EXACT 1
+#endif
+
+#if SFG_RAYCASTING_MAX_STEPS >= 200
+  /* Hash of the default build's rendering with steps enough to see across any
+     level, SFG_SKIP_UNIFORM_BLOCKS then has to render the same. */
+  #define TEST_RENDER_HASH 2382477993
+#else
+  #define TEST_RENDER_HASH 1221007774 ///< hash of the default build's rendering
+#endif
+
 uint8_t screen[SFG_SCREEN_RESOLUTION_X * SFG_SCREEN_RESOLUTION_Y];
 uint8_t keys[SFG_KEY_COUNT];
 
@@ -103,6 +118,15 @@ void printScreen()
   }
 }
 
+uint32_t hashScreen(uint32_t hash)
+{
+  for (uint16_t i = 0; i < SFG_SCREEN_RESOLUTION_X * SFG_SCREEN_RESOLUTION_Y;
+    ++i)
+    hash = (hash ^ screen[i]) * 16777619; // FNV-1a
+
+  return hash;
+}
+
 int main(void)
 {
   puts("===== TESTING ANARCH =====\n");
@@ -295,6 +319,278 @@ int main(void)
     #undef RELEASE
     #undef STEP
   }
+
+  {
+    printTestHeading("rendering");
+
+    /* Each level is played for a while with fixed input, moving and turning
+       and then standing still, and all the frames are hashed. */
+
+    uint32_t renderHash = 2166136261;
+
+    for (uint8_t level = 0; level < SFG_NUMBER_OF_LEVELS; ++level)
+    {
+      SFG_setAndInitLevel(level);
+      SFG_setGameState(SFG_GAME_STATE_PLAYING);
+
+      for (uint16_t frame = 0; frame < 120; ++frame)
+      {
+        for (uint8_t i = 0; i < SFG_KEY_COUNT; ++i)
+          keys[i] = 0;
+
+        if (frame < 90)
+        {
+          keys[SFG_KEY_UP] = (frame / 15) % 2;
+          keys[(frame / 30) % 2 ? SFG_KEY_LEFT : SFG_KEY_RIGHT] = 1;
+        }
+
+        SFG_player.health = 100; // don't die
+
+        gameTime += 33;
+        SFG_mainLoopBody();
+
+        renderHash = hashScreen(renderHash);
+
+#if SFG_ADAPTIVE_RAY_BUDGETS
+        if (frame == 0)
+        {
+          // nothing was rendered before, so no column can have a lower budget
+          uint8_t full = 1;
+
+          for (int16_t i = 0; i < SFG_player.camera.resolution.x; ++i)
+            full &= SFG_game.rayColumnInfo[i].maxSteps ==
+              SFG_game.rayConstraints.maxSteps &&
+              SFG_game.rayColumnInfo[i].maxHits ==
+              SFG_game.rayConstraints.maxHits;
+
+          ASSERT("full ray budgets in first frame",full)
+        }
+#endif
+      }
+    }
+
+    printf("render hash: %u\n",renderHash);
+
+#if TEST_RENDER_EXACT
+    ASSERT("rendering same as default",renderHash == TEST_RENDER_HASH)
+#endif
+
+#if SFG_MIPMAPS
+    {
+      /* Each texel of a MIP map level has to be one of the four texels of the
+         bigger level it is made of, and farther walls mustn't use bigger
+         levels. */
+
+      uint8_t ok = 1;
+      RCL_Unit texel = RCL_UNITS_PER_SQUARE / SFG_TEXTURE_SIZE;
+
+      for (uint8_t i = 0; i < 8; ++i)
+      {
+        uint8_t texture = i < 7 ? i : 255; // the 7 level textures and door
+
+        for (uint8_t level = 1; level < SFG_MIPMAP_LEVELS; ++level)
+          for (int16_t x = 0; x < (SFG_TEXTURE_SIZE >> level); ++x)
+            for (int16_t y = 0; y < (SFG_TEXTURE_SIZE >> level); ++y)
+            {
+              uint8_t color = SFG_getTexelMipmap(texture,level,
+                (x << level) * texel,(y << level) * texel);
+
+              uint8_t found = 0;
+
+              for (uint8_t j = 0; j < 4; ++j)
+                found |= color == SFG_getTexelMipmap(texture,level - 1,
+                  ((2 * x + j / 2) << (level - 1)) * texel,
+                  ((2 * y + j % 2) << (level - 1)) * texel);
+
+              ok &= found;
+            }
+      }
+
+      ASSERT("MIP map texels from bigger level",ok)
+
+      uint8_t previousLevel = 0;
+
+      for (RCL_Unit depth = 0; depth < 32 * RCL_UNITS_PER_SQUARE; depth += 64)
+      {
+        uint8_t level = SFG_mipmapLevel(depth);
+
+        ok &= level >= previousLevel;
+        previousLevel = level;
+      }
+
+      ASSERT("MIP map levels don't get bigger with depth",
+        ok && previousLevel > 0)
+    }
+#endif
+
+#if SFG_SORTED_SPRITES
+    {
+      /* Overlapping sprites have to end up the same whatever order they are
+         submitted in, with the nearest one on top. */
+
+      uint32_t hashes[2], blankHash = 0;
+
+      for (uint8_t order = 0; order < 2; ++order)
+      {
+        for (uint16_t i = 0; i < SFG_SCREEN_RESOLUTION_X *
+          SFG_SCREEN_RESOLUTION_Y; ++i)
+          screen[i] = 0;
+
+        blankHash = hashScreen(0);
+
+        for (uint16_t i = 0; i < SFG_Z_BUFFER_SIZE; ++i)
+          SFG_game.zBuffer[i] = 255;
+
+#if SFG_FULL_Z_BUFFER
+        for (uint16_t i = 0; i < sizeof(SFG_depthBuffer.pixels); ++i)
+          SFG_depthBuffer.pixels[i] = 255;
+
+        for (uint16_t i = 0; i < sizeof(SFG_depthBuffer.tileMin); ++i)
+        {
+          SFG_depthBuffer.tileMin[i] = 255;
+          SFG_depthBuffer.tileMax[i] = 255;
+        }
+#endif
+
+        for (uint8_t i = 0; i < 3; ++i)
+        {
+          uint8_t sprite = order ? 2 - i : i;
+
+          SFG_submitSprite(SFG_monsterSprites +
+            sprite * SFG_TEXTURE_STORE_SIZE,
+            SFG_GAME_RESOLUTION_X / 2 + sprite * 4,
+            SFG_GAME_RESOLUTION_Y / 2,SFG_GAME_RESOLUTION_Y / 2,0,
+            (sprite + 2) * RCL_UNITS_PER_SQUARE);
+        }
+
+        uint8_t sorted = SFG_spriteQueue.count == 3;
+
+        for (uint8_t i = 1; i < SFG_spriteQueue.count; ++i)
+          sorted &= SFG_spriteQueue.sprites[i - 1].distance <=
+            SFG_spriteQueue.sprites[i].distance;
+
+        ASSERT("sprites sorted by distance",sorted)
+
+        SFG_drawSpriteQueue();
+        hashes[order] = hashScreen(0);
+      }
+
+      ASSERT("sprites drawn",
+        SFG_spriteQueue.count == 0 && hashes[0] != blankHash)
+      ASSERT("sprites same in any order",hashes[0] == hashes[1])
+    }
+#endif
+
+#if SFG_FULL_Z_BUFFER
+    {
+      /* The tiles have to keep the exact minimum and maximum of their pixels,
+         and the rows found for sprites have to be the same as when comparing
+         pixel by pixel. */
+
+      SFG_draw();
+
+      uint8_t ok = 1, walls = 0;
+
+      for (uint16_t tileY = 0; tileY < SFG_DEPTH_TILES_Y; ++tileY)
+        for (uint16_t tileX = 0; tileX < SFG_DEPTH_TILES_X; ++tileX)
+        {
+          uint8_t minValue = 255, maxValue = 0;
+
+          for (uint16_t y = tileY * SFG_DEPTH_TILE_SIZE; y <
+            RCL_min((tileY + 1) * SFG_DEPTH_TILE_SIZE,SFG_DEPTH_BUFFER_HEIGHT);
+            ++y)
+            for (uint16_t x = tileX * SFG_DEPTH_TILE_SIZE; x <
+              RCL_min((tileX + 1) * SFG_DEPTH_TILE_SIZE,SFG_DEPTH_BUFFER_WIDTH);
+              ++x)
+            {
+              uint8_t value =
+                SFG_depthBuffer.pixels[y * SFG_DEPTH_BUFFER_WIDTH + x];
+
+              minValue = RCL_min(minValue,value);
+              maxValue = RCL_max(maxValue,value);
+            }
+
+          uint16_t tile = tileY * SFG_DEPTH_TILES_X + tileX;
+
+          ok &= SFG_depthBuffer.tileMin[tile] == minValue &&
+            SFG_depthBuffer.tileMax[tile] == maxValue;
+          walls |= minValue != 255;
+        }
+
+      ASSERT("depth tiles bound their pixels",ok && walls)
+
+      uint8_t inFront[SFG_GAME_RESOLUTION_Y];
+
+      for (uint16_t zDistance = 1; zDistance < 256; zDistance += 15)
+        for (int16_t x = 0; x < SFG_GAME_RESOLUTION_X; ++x)
+        {
+          int16_t y = 0, rangeTo;
+
+          for (int16_t i = 0; i < SFG_GAME_RESOLUTION_Y; ++i)
+            inFront[i] = 0;
+
+          while (y < SFG_GAME_RESOLUTION_Y && SFG_spriteRowsInFront(x,
+            zDistance,&y,SFG_GAME_RESOLUTION_Y - 1,&rangeTo))
+            for (; y <= rangeTo; ++y)
+              inFront[y] = 1;
+
+          for (int16_t i = 0; i < SFG_GAME_RESOLUTION_Y; ++i)
+            ok &= inFront[i] == (i >= SFG_DEPTH_BUFFER_HEIGHT ||
+              SFG_depthBuffer.pixels[i * SFG_DEPTH_BUFFER_WIDTH +
+              x / SFG_RAYCASTING_SUBSAMPLE] >= zDistance);
+        }
+
+      ASSERT("sprite rows in front of walls",ok)
+    }
+#endif
+
+#if SFG_INTERLACED_RENDERING
+    /* When nothing changes, the halves of the view rendered in turns have to
+       make up the same view as when rendered whole. The kept view is cleared
+       so that the second half can only come from the first one. */
+
+    SFG_viewCache.complete = 0; // makes the next view whole
+    SFG_draw();
+    uint32_t wholeHash = hashScreen(0);
+
+    for (uint32_t i = 0; i < sizeof(SFG_viewCache.pixels); ++i)
+      SFG_viewCache.pixels[i] = 0;
+
+    SFG_draw();
+    ASSERT("half of the view rendered",hashScreen(0) != wholeHash)
+
+    SFG_draw();
+    ASSERT("interlaced halves same as whole view",hashScreen(0) == wholeHash)
+#endif
+
+#if SFG_DYNAMIC_RESOLUTION
+    // a full load lowers the resolution, no load raises it back
+
+    SFG_draw();
+    uint32_t fullHash = hashScreen(0);
+
+    for (uint8_t i = 0; i < SFG_DYNAMIC_RESOLUTION_PERIOD_FRAMES *
+      (SFG_DYNAMIC_RESOLUTION_MAX_X + SFG_DYNAMIC_RESOLUTION_MAX_Y); ++i)
+      SFG_updateDynamicResolution(100);
+
+    ASSERT("lowest resolution",
+      SFG_game.resolutionScaleX == SFG_DYNAMIC_RESOLUTION_MAX_X &&
+      SFG_game.resolutionScaleY == SFG_DYNAMIC_RESOLUTION_MAX_Y)
+
+    SFG_draw();
+    ASSERT("lowered resolution rendered",hashScreen(0) != fullHash)
+
+    for (uint8_t i = 0; i < SFG_DYNAMIC_RESOLUTION_PERIOD_FRAMES *
+      (SFG_DYNAMIC_RESOLUTION_MAX_X + SFG_DYNAMIC_RESOLUTION_MAX_Y); ++i)
+      SFG_updateDynamicResolution(0);
+
+    ASSERT("full resolution",
+      SFG_game.resolutionScaleX == 1 && SFG_game.resolutionScaleY == 1)
+
+    SFG_draw();
+    ASSERT("full resolution rendered again",hashScreen(0) == fullHash)
+#endif
+  }
  
   puts("======================================\n\nDone.\nEverything seems OK.");
 
@@ -70,6 +70,35 @@ elif [ "$FRONTEND" = "test" ]; then
   # - g++
 
   COMMAND="${COMPILER} ${C_FLAGS} main_test.c"
+elif [ "$FRONTEND" = "tests" ]; then
+  # builds and runs the test with each of the setting sets below, requires:
+  # - g++
+  # - POSIX threads
+  # - UBSan (-fsanitize)
+  #
+  # The rendering of those which only optimize has to be the same as that of the
+  # default build, the others set TEST_RENDER_EXACT to 0 (see main_test.c).
+
+  COMMAND="for s in \
+    '' \
+    '-DSFG_RENDER_THREADS=4 -pthread' \
+    '-DSFG_SQUARE_GRID=1' \
+    '-DSFG_SQUARE_GRID=1 -DSFG_STREAM_HITS=1' \
+    '-DSFG_ADAPTIVE_RAY_BUDGETS=1' \
+    '-DSFG_REUSE_STATIC_FRAMES=1' \
+    '-DSFG_DYNAMIC_RESOLUTION=1' \
+    '-DSFG_RAYCASTING_MAX_STEPS=200' \
+    '-DSFG_SQUARE_GRID=1 -DSFG_SKIP_UNIFORM_BLOCKS=1
+      -DSFG_RAYCASTING_MAX_STEPS=200' \
+    '-DSFG_SQUARE_GRID=1 -DSFG_SKIP_UNIFORM_BLOCKS=1 -DTEST_RENDER_EXACT=0
+      -fsanitize=signed-integer-overflow -fno-sanitize-recover' \
+    '-DSFG_INTERLACED_RENDERING=1 -DTEST_RENDER_EXACT=0' \
+    '-DSFG_MIPMAPS=1 -DTEST_RENDER_EXACT=0' \
+    '-DSFG_SORTED_SPRITES=1 -DTEST_RENDER_EXACT=0' \
+    '-DSFG_FULL_Z_BUFFER=1 -DTEST_RENDER_EXACT=0' \
+    ; do echo \"testing with: \$s\";
+    ${COMPILER} ${C_FLAGS} main_test.c \$s && ./anarch > /dev/null ||
+    { echo \"FAILED with: \$s\"; exit 1; }; done; echo 'all tests OK'"
 elif [ "$FRONTEND" = "pokitto" ]; then
   # Pokitto build, requires:
   # - PokittoLib, in this folder create a symlink named "PokittoLib" to the 
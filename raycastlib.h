@@ -143,6 +143,26 @@
 #define RCL_CAMERA_COLL_STEP_HEIGHT (RCL_UNITS_PER_SQUARE / 2)
 #endif
 
+#ifndef RCL_STREAM_HITS
+  #define RCL_STREAM_HITS 0 /**< If on, complex rendering casts the rays lazily,
+                                 taking the hits one by one while drawing a
+                                 column and stopping as soon as the column is
+                                 fully covered, so that the cost depends on
+                                 the visible walls rather than on
+                                 RCL_RayConstraints::maxHits. The result is the
+                                 same. */
+#endif
+
+#ifndef RCL_SKIP_UNIFORM_BLOCKS
+  #define RCL_SKIP_UNIFORM_BLOCKS 0 /**< If on, rays cast through the square
+                                         grid cross each uniform block (see
+                                         RCL_GridSquare::blockLevel) in a single
+                                         step, which counts as one step towards
+                                         RCL_RayConstraints::maxSteps, so the
+                                         same number of steps reaches much
+                                         farther. */
+#endif
+
 #ifndef RCL_TEXTURE_INTERPOLATION_SCALE
   #define RCL_TEXTURE_INTERPOLATION_SCALE 1024 /**< This says scaling of fixed
                                              poit vertical texture coord
@@ -278,6 +298,36 @@ typedef struct
 
 void RCL_PIXEL_FUNCTION (RCL_PixelInfo *pixel);
 
+/**
+  Describes a vertical span of pixels for the optional span function. If
+  RCL_SPAN_FUNCTION is defined (as a name of the function, similarly to
+  RCL_PIXEL_FUNCTION), the complex rendering calls it once for each vertical
+  span of wall, floor or ceiling pixels instead of calling RCL_PIXEL_FUNCTION
+  for each of the pixels (except for floor pixels with computed texture
+  coordinates). The function gets the pixel info of the first pixel in the span
+  and the span info, the i-th pixel of the span (counting from 0) then only
+  differs from the first pixel in:
+
+  - position.y, which is (position.y + i * increment),
+  - depth, which is RCL_zeroClamp(depth + i * depthIncrement) (with depth and
+    depthIncrement taken from the span info),
+  - texCoords.y (walls only and only if RCL_COMPUTE_WALL_TEXCOORDS), which is
+    (texCoordScaled + i * texCoordStepScaled) / RCL_TEXTURE_INTERPOLATION_SCALE.
+*/
+typedef struct
+{
+  int16_t length;              ///< Number of pixels in the span.
+  int8_t increment;            ///< 1 (span goes down) or -1 (span goes up).
+  RCL_Unit depth;              ///< Depth of the first pixel, not clamped to 0.
+  RCL_Unit depthIncrement;
+  RCL_Unit texCoordScaled;     ///< Scaled vertical tex. coord of first pixel.
+  RCL_Unit texCoordStepScaled;
+} RCL_SpanInfo;
+
+#ifdef RCL_SPAN_FUNCTION
+void RCL_SPAN_FUNCTION (RCL_PixelInfo *pixel, RCL_SpanInfo *span);
+#endif
+
 typedef struct
 {
   uint16_t maxHits;
@@ -312,6 +362,46 @@ typedef void
   (*RCL_ColumnFunction)(RCL_HitResult *hits, uint16_t hitCount, uint16_t x,
    RCL_Ray ray);
 
+/**
+  Square of an optional precomputed square grid (see RCL_setSquareGrid(...)),
+  it holds everything the complex renderer needs to know about the square.
+  Heights have to fit in 16 bits (which is also assumed when the floor and
+  ceiling heights are combined for collision checking) and the type in 8 bits.
+*/
+typedef struct
+{
+  int16_t floorHeight;
+  int16_t ceilingHeight;
+  uint8_t type;
+  uint8_t blockLevel; /**< Says the square lies in an aligned block of 2^N x
+                           2^N squares of the same heights, N = blockLevel
+                           (0 = just the square itself). This is only used with
+                           RCL_SKIP_UNIFORM_BLOCKS and must be kept 0 for
+                           squares whose heights change. */
+} RCL_GridSquare;
+
+/**
+  Per screen column information for complex rendering (see
+  RCL_setColumnInfo(...)), it holds the column's own ray budget (input), how
+  much of it the column actually needed and how deep the column could be seen
+  (output).
+*/
+typedef struct
+{
+  uint16_t maxHits;   /**< Hit budget of the column's ray, capped by the
+                           constraints. */
+  uint16_t maxSteps;  ///< Step budget of the column's ray, capped likewise.
+  uint16_t usedHits;  /**< Hits the column needed, i.e. until it was fully
+                           covered or all found hits if it never was. */
+  uint16_t usedSteps; ///< Steps done until the last needed hit was found.
+  RCL_Unit firstHitDepth; /**< Distance of the first hit, i.e. there is no
+                           change of floor or ceiling height in front of
+                           it, RCL_INFINITY if the ray hit nothing. */
+  RCL_Unit coverDepth; /**< Distance of the hit at which the column got fully
+                           covered, i.e. nothing behind it can be seen,
+                           RCL_INFINITY if it never got covered. */
+} RCL_ColumnInfo;
+
 /**
   Simple-interface function to cast a single ray.
 
@@ -338,6 +428,17 @@ RCL_Unit RCL_castRay3D(
 RCL_PixelInfo RCL_mapToScreen(RCL_Vector2D worldPosition, RCL_Unit height,
   RCL_Camera camera);
 
+/**
+  Maps many points in the world to the screen at once, giving the same results
+  as RCL_mapToScreen for each one. Coordinates are passed and returned in
+  separate arrays so that the rotation to camera space can be done in one
+  simple loop (which compilers can vectorize). Screen positions are only
+  computed for points in front of the camera (depth > 0).
+*/
+void RCL_mapToScreenMany(const RCL_Unit *positionsX,
+  const RCL_Unit *positionsY, const RCL_Unit *heights, uint16_t count,
+  RCL_Camera camera, RCL_Unit *depths, RCL_Unit *screenX, RCL_Unit *screenY);
+
 /**
   Casts a single ray and returns a list of collisions.
 
@@ -415,6 +516,17 @@ void RCL_castRaysMultiHit(RCL_Camera cam, RCL_ArrayFunction arrayFunc,
   RCL_ArrayFunction typeFunction, RCL_ColumnFunction columnFunc,
   RCL_RayConstraints constraints);
 
+/**
+  Same as RCL_castRaysMultiHit but only casts rays for screen columns from
+  fromColumn (including) to toColumn (excluding). Rays cast this way are exactly
+  the same as those cast by RCL_castRaysMultiHit, so the screen can be split
+  into several column ranges that are processed independently (e.g. in
+  parallel).
+*/
+void RCL_castRaysMultiHitColumns(RCL_Camera cam, RCL_ArrayFunction arrayFunc,
+  RCL_ArrayFunction typeFunction, RCL_ColumnFunction columnFunc,
+  RCL_RayConstraints constraints, int16_t fromColumn, int16_t toColumn);
+
 /**
   Using provided functions, renders a complete complex (multilevel) camera
   view.
@@ -446,6 +558,58 @@ void RCL_renderComplex(RCL_Camera cam, RCL_ArrayFunction floorHeightFunc,
   RCL_ArrayFunction ceilingHeightFunc, RCL_ArrayFunction typeFunction,
   RCL_RayConstraints constraints);
 
+/**
+  Sets up the rendering of a complex camera view without rendering anything,
+  the view can then be rendered by RCL_renderComplexColumns(...). Parameters
+  are the same as in RCL_renderComplex(...).
+*/
+void RCL_renderComplexBegin(RCL_Camera cam, RCL_ArrayFunction floorHeightFunc,
+  RCL_ArrayFunction ceilingHeightFunc);
+
+/**
+  Renders screen columns from fromColumn (including) to toColumn (excluding) of
+  the view set up with RCL_renderComplexBegin(...), the result is the same as
+  that of RCL_renderComplex(...). This only reads the state set up by
+  RCL_renderComplexBegin(...), so different column ranges can be rendered
+  concurrently (e.g. by different threads) as long as the pixel function can be
+  called so too. Floor texture coordinates (RCL_COMPUTE_FLOOR_TEXCOORDS) are
+  not supported by this function.
+*/
+void RCL_renderComplexColumns(RCL_ArrayFunction typeFunction,
+  RCL_RayConstraints constraints, int16_t fromColumn, int16_t toColumn);
+
+/**
+  Sets a precomputed grid of squares which the complex rendering functions
+  will read directly instead of calling the floor height, ceiling height and
+  type functions for each square, which is much faster. The functions still
+  have to be passed to the rendering functions as they say whether there is a
+  ceiling or type at all, but they won't be called. The grid holds sizeX *
+  sizeY squares stored row by row, all squares outside of it are considered
+  to be the outside square. The user has to keep the grid up to date (e.g.
+  update the squares whose height changes over time before each frame). 0 turns
+  the grid off.
+*/
+void RCL_setSquareGrid(const RCL_GridSquare *grid, int16_t sizeX,
+  int16_t sizeY, RCL_GridSquare outside);
+
+/**
+  Sets an array of per column information (one item for each screen column)
+  for complex rendering. Each column's ray is then constrained by the budget
+  stored in its item and the usage is recorded there, which allows to adapt
+  the budgets from frame to frame. The depths up to which the column can be
+  seen are recorded too (e.g. for sprite visibility). 0 turns this off.
+*/
+void RCL_setColumnInfo(RCL_ColumnInfo *columnInfo);
+
+/**
+  Makes complex rendering only render every step-th screen column, starting
+  with column offset (e.g. step 2 and offset 0 renders only the even columns),
+  the other columns are left untouched. This allows to e.g. render the odd and
+  even columns in alternating frames. Step 1 and offset 0 (default) renders
+  all columns.
+*/
+void RCL_setColumnStep(uint16_t step, uint16_t offset);
+
 /**
   Renders given camera view, with help of provided functions. This function is
   simpler and faster than RCL_renderComplex(...) and is meant to be rendering
@@ -521,6 +685,13 @@ int16_t _RCL_cameraHeightScreen = 0;
 RCL_ArrayFunction _RCL_rollFunction = 0; // says door rolling
 RCL_Unit *_RCL_floorPixelDistances = 0;
 RCL_Unit _RCL_fovCorrectionFactors[2] = {0,0}; //correction for hor/vert fov
+const RCL_GridSquare *_RCL_grid = 0;
+int16_t _RCL_gridSizeX = 0;
+int16_t _RCL_gridSizeY = 0;
+RCL_GridSquare _RCL_gridOutside;
+RCL_ColumnInfo *_RCL_columnInfo = 0;
+uint16_t _RCL_columnStep = 1;
+uint16_t _RCL_columnOffset = 0;
 
 RCL_Unit RCL_clamp(RCL_Unit value, RCL_Unit valueMin, RCL_Unit valueMax)
 {
@@ -737,208 +908,414 @@ static inline int8_t RCL_pointIsLeftOfRay(RCL_Vector2D point, RCL_Ray ray)
          // ^ Z component of cross-product
 }
 
-void RCL_castRayMultiHit(RCL_Ray ray, RCL_ArrayFunction arrayFunc,
-  RCL_ArrayFunction typeFunc, RCL_HitResult *hitResults,
-  uint16_t *hitResultsLen, RCL_RayConstraints constraints)
+void RCL_setSquareGrid(const RCL_GridSquare *grid, int16_t sizeX,
+  int16_t sizeY, RCL_GridSquare outside)
 {
-  RCL_Vector2D currentPos = ray.start;
-  RCL_Vector2D currentSquare;
+  _RCL_grid = grid;
+  _RCL_gridSizeX = sizeX;
+  _RCL_gridSizeY = sizeY;
+  _RCL_gridOutside = outside;
+}
 
-  currentSquare.x = RCL_divRoundDown(ray.start.x,RCL_UNITS_PER_SQUARE);
-  currentSquare.y = RCL_divRoundDown(ray.start.y,RCL_UNITS_PER_SQUARE);
+void RCL_setColumnInfo(RCL_ColumnInfo *columnInfo)
+{
+  _RCL_columnInfo = columnInfo;
+}
 
-  *hitResultsLen = 0;
+void RCL_setColumnStep(uint16_t step, uint16_t offset)
+{
+  _RCL_columnStep = step;
+  _RCL_columnOffset = offset;
+}
 
-  RCL_Unit squareType = arrayFunc(currentSquare.x,currentSquare.y);
+static inline const RCL_GridSquare *_RCL_gridSquareAt(int16_t x, int16_t y)
+{
+  return (x >= 0 && y >= 0 && x < _RCL_gridSizeX && y < _RCL_gridSizeY) ?
+    (_RCL_grid + y * _RCL_gridSizeX + x) : &_RCL_gridOutside;
+}
 
-  // DDA variables
-  RCL_Vector2D nextSideDist; // dist. from start to the next side in given axis
-  RCL_Vector2D delta;
-  RCL_Vector2D step;         // -1 or 1 for each axis
-  int8_t stepHorizontal = 0; // whether the last step was hor. or vert.
+/**
+  Returns the same value as _RCL_floorCeilFunction but for a grid square.
+*/
+static inline RCL_Unit _RCL_gridFloorCeilValue(const RCL_GridSquare *square)
+{
+  if (_RCL_ceilFunction == 0)
+    return square->floorHeight;
 
-  nextSideDist.x = 0;
-  nextSideDist.y = 0;
+#ifndef RCL_RAYCAST_TINY
+  return (((RCL_Unit) square->floorHeight & 0x0000ffff) << 16) |
+    ((RCL_Unit) square->ceilingHeight & 0x0000ffff);
+#else
+  return ((square->floorHeight & 0x00ff) << 8) |
+    (square->ceilingHeight & 0x00ff);
+#endif
+}
 
-  RCL_Unit dirVecLengthNorm = RCL_len(ray.direction) * RCL_UNITS_PER_SQUARE;
+static inline RCL_Unit _RCL_floorHeightAt(int16_t x, int16_t y)
+{
+  return _RCL_grid != 0 ? _RCL_gridSquareAt(x,y)->floorHeight :
+    _RCL_floorFunction(x,y);
+}
 
-  delta.x = RCL_abs(dirVecLengthNorm / RCL_nonZero(ray.direction.x));
-  delta.y = RCL_abs(dirVecLengthNorm / RCL_nonZero(ray.direction.y));
+static inline RCL_Unit _RCL_ceilHeightAt(int16_t x, int16_t y)
+{
+  return _RCL_grid != 0 ? _RCL_gridSquareAt(x,y)->ceilingHeight :
+    _RCL_ceilFunction(x,y);
+}
 
-  // init DDA
+#define _RCL_RECIP_SCALE 65536 /**< Scale of the ray direction reciprocals we
+                                    precompute to avoid divisions. */
+
+/**
+  Initializes the DDA variables for given ray, helper for the ray casting
+  functions.
+*/
+static inline void _RCL_initDDA(RCL_Ray ray, RCL_Vector2D *currentSquare,
+  RCL_Vector2D *nextSideDist, RCL_Vector2D *delta, RCL_Vector2D *step,
+  RCL_Unit *rayDirXRecip, RCL_Unit *rayDirYRecip)
+{
+  currentSquare->x = RCL_divRoundDown(ray.start.x,RCL_UNITS_PER_SQUARE);
+  currentSquare->y = RCL_divRoundDown(ray.start.y,RCL_UNITS_PER_SQUARE);
+
+  RCL_Unit dirVecLengthNorm = RCL_len(ray.direction) * RCL_UNITS_PER_SQUARE;
+
+  delta->x = RCL_abs(dirVecLengthNorm / RCL_nonZero(ray.direction.x));
+  delta->y = RCL_abs(dirVecLengthNorm / RCL_nonZero(ray.direction.y));
 
   if (ray.direction.x < 0)
   {
-    step.x = -1;
-    nextSideDist.x = (RCL_wrap(ray.start.x,RCL_UNITS_PER_SQUARE) * delta.x) /
+    step->x = -1;
+    nextSideDist->x = (RCL_wrap(ray.start.x,RCL_UNITS_PER_SQUARE) * delta->x) /
                        RCL_UNITS_PER_SQUARE;
   }
   else
   {
-    step.x = 1;
-    nextSideDist.x =
+    step->x = 1;
+    nextSideDist->x =
       ((RCL_wrap(RCL_UNITS_PER_SQUARE - ray.start.x,RCL_UNITS_PER_SQUARE)) *
-        delta.x) / RCL_UNITS_PER_SQUARE;
+        delta->x) / RCL_UNITS_PER_SQUARE;
   }
 
   if (ray.direction.y < 0)
   {
-    step.y = -1;
-    nextSideDist.y = (RCL_wrap(ray.start.y,RCL_UNITS_PER_SQUARE) * delta.y) /
+    step->y = -1;
+    nextSideDist->y = (RCL_wrap(ray.start.y,RCL_UNITS_PER_SQUARE) * delta->y) /
                        RCL_UNITS_PER_SQUARE;
   }
   else
   {
-    step.y = 1;
-    nextSideDist.y =
+    step->y = 1;
+    nextSideDist->y =
       ((RCL_wrap(RCL_UNITS_PER_SQUARE - ray.start.y,RCL_UNITS_PER_SQUARE)) *
-        delta.y) / RCL_UNITS_PER_SQUARE;
+        delta->y) / RCL_UNITS_PER_SQUARE;
   }
 
-  // DDA loop
-
-  #define RECIP_SCALE 65536
+  *rayDirXRecip = _RCL_RECIP_SCALE / RCL_nonZero(ray.direction.x);
+  *rayDirYRecip = _RCL_RECIP_SCALE / RCL_nonZero(ray.direction.y);
+}
 
-  RCL_Unit rayDirXRecip = RECIP_SCALE / RCL_nonZero(ray.direction.x);
-  RCL_Unit rayDirYRecip = RECIP_SCALE / RCL_nonZero(ray.direction.y);
-  // ^ we precompute reciprocals to avoid divisions in the loop
+/**
+  Computes the hit result of a ray entering given square by the last DDA step
+  (stepHorizontal and step say what the step was), helper for the ray casting
+  functions. The hit type is not set.
+*/
+static inline void _RCL_makeHit(RCL_HitResult *h, RCL_Ray ray,
+  RCL_Vector2D square, int8_t stepHorizontal, RCL_Vector2D step,
+  RCL_Unit rayDirXRecip, RCL_Unit rayDirYRecip, RCL_Unit arrayValue)
+{
+  h->arrayValue = arrayValue;
+  h->doorRoll = 0;
+  h->square = square;
 
-  for (uint16_t i = 0; i < constraints.maxSteps; ++i)
+  if (stepHorizontal)
   {
-    RCL_Unit currentType = arrayFunc(currentSquare.x,currentSquare.y);
+    h->position.x = square.x * RCL_UNITS_PER_SQUARE;
+    h->direction = 3;
 
-    if (RCL_unlikely(currentType != squareType))
+    if (step.x == -1)
     {
-      // collision
-
-      RCL_HitResult h;
-
-      h.arrayValue = currentType;
-      h.doorRoll = 0;
-      h.position = currentPos;
-      h.square   = currentSquare;
-
-      if (stepHorizontal)
-      {
-        h.position.x = currentSquare.x * RCL_UNITS_PER_SQUARE;
-        h.direction = 3;
-
-        if (step.x == -1)
-        {
-          h.direction = 1;
-          h.position.x += RCL_UNITS_PER_SQUARE;
-        }
+      h->direction = 1;
+      h->position.x += RCL_UNITS_PER_SQUARE;
+    }
 
-        RCL_Unit diff = h.position.x - ray.start.x;
+    RCL_Unit diff = h->position.x - ray.start.x;
 
-        h.position.y = // avoid division by multiplying with reciprocal
-          ray.start.y + (ray.direction.y * diff * rayDirXRecip) / RECIP_SCALE;
+    /* Avoid division by multiplying with reciprocal, in 64 bits as long rays
+       (e.g. with block skipping) would overflow. */
+    h->position.y = ray.start.y +
+      ((int64_t) ray.direction.y * diff * rayDirXRecip) / _RCL_RECIP_SCALE;
 
 #if RCL_RECTILINEAR
-        /* Here we compute the fish eye corrected distance (perpendicular to
-        the projection plane) as the Euclidean distance (of hit from camera
-        position) divided by the length of the ray direction vector. This can
-        be computed without actually computing Euclidean distances as a
-        hypothenuse A (distance) divided by hypothenuse B (length) is equal to
-        leg A (distance along principal axis) divided by leg B (length along
-        the same principal axis). */
+    /* Here we compute the fish eye corrected distance (perpendicular to
+    the projection plane) as the Euclidean distance (of hit from camera
+    position) divided by the length of the ray direction vector. This can
+    be computed without actually computing Euclidean distances as a
+    hypothenuse A (distance) divided by hypothenuse B (length) is equal to
+    leg A (distance along principal axis) divided by leg B (length along
+    the same principal axis). */
 
 #define CORRECT(dir1,dir2)\
   RCL_Unit tmp = diff / 4;        /* 4 to prevent overflow */ \
-  h.distance = ((tmp / 8) != 0) ? /* prevent a bug with small dists */ \
-    ((tmp * RCL_UNITS_PER_SQUARE * rayDir ## dir1 ## Recip) / (RECIP_SCALE / 4)):\
-    RCL_abs(h.position.dir2 - ray.start.dir2);
+  h->distance = ((tmp / 8) != 0) ? /* prevent a bug with small dists */ \
+    (((int64_t) tmp * RCL_UNITS_PER_SQUARE * rayDir ## dir1 ## Recip) /\
+    (_RCL_RECIP_SCALE / 4)): RCL_abs(h->position.dir2 - ray.start.dir2);
 
-        CORRECT(X,y)
+    CORRECT(X,y)
 
 #endif // RCL_RECTILINEAR
-      }
-      else
-      {
-        h.position.y = currentSquare.y * RCL_UNITS_PER_SQUARE;
-        h.direction = 2;
+  }
+  else
+  {
+    h->position.y = square.y * RCL_UNITS_PER_SQUARE;
+    h->direction = 2;
 
-        if (step.y == -1)
-        {
-          h.direction = 0;
-          h.position.y += RCL_UNITS_PER_SQUARE;
-        }
+    if (step.y == -1)
+    {
+      h->direction = 0;
+      h->position.y += RCL_UNITS_PER_SQUARE;
+    }
 
-        RCL_Unit diff = h.position.y - ray.start.y;
+    RCL_Unit diff = h->position.y - ray.start.y;
 
-        h.position.x =
-          ray.start.x + (ray.direction.x * diff * rayDirYRecip) / RECIP_SCALE;
+    h->position.x = ray.start.x +
+      ((int64_t) ray.direction.x * diff * rayDirYRecip) / _RCL_RECIP_SCALE;
 
 #if RCL_RECTILINEAR
 
-        CORRECT(Y,x) // same as above but for different axis
+    CORRECT(Y,x) // same as above but for different axis
 
 #undef CORRECT
 
 #endif // RCL_RECTILINEAR
-      }
+  }
 
 #if !RCL_RECTILINEAR
-      h.distance = RCL_dist(h.position,ray.start);
+  h->distance = RCL_dist(h->position,ray.start);
 #endif
-      if (typeFunc != 0)
-        h.type = typeFunc(currentSquare.x,currentSquare.y);
 
 #if RCL_COMPUTE_WALL_TEXCOORDS == 1
-      switch (h.direction)
-      {
-        case 0: h.textureCoord =
-          RCL_wrap(-1 * h.position.x,RCL_UNITS_PER_SQUARE); break;
-
-        case 1: h.textureCoord =
-          RCL_wrap(h.position.y,RCL_UNITS_PER_SQUARE); break;
+  switch (h->direction)
+  {
+    case 0: h->textureCoord =
+      RCL_wrap(-1 * h->position.x,RCL_UNITS_PER_SQUARE); break;
 
-        case 2: h.textureCoord =
-          RCL_wrap(h.position.x,RCL_UNITS_PER_SQUARE); break;
+    case 1: h->textureCoord =
+      RCL_wrap(h->position.y,RCL_UNITS_PER_SQUARE); break;
 
-        case 3: h.textureCoord =
-          RCL_wrap(-1 * h.position.y,RCL_UNITS_PER_SQUARE); break;
+    case 2: h->textureCoord =
+      RCL_wrap(h->position.x,RCL_UNITS_PER_SQUARE); break;
 
-        default: h.textureCoord = 0; break;
-      }
+    case 3: h->textureCoord =
+      RCL_wrap(-1 * h->position.y,RCL_UNITS_PER_SQUARE); break;
 
-      if (_RCL_rollFunction != 0)
-      {
-        h.doorRoll = _RCL_rollFunction(currentSquare.x,currentSquare.y);
-        
-        if (h.direction == 0 || h.direction == 1)
-          h.doorRoll *= -1;
-      }
+    default: h->textureCoord = 0; break;
+  }
 
+  if (_RCL_rollFunction != 0)
+  {
+    h->doorRoll = _RCL_rollFunction(square.x,square.y);
+    
+    if (h->direction == 0 || h->direction == 1)
+      h->doorRoll *= -1;
+  }
 #else
-      h.textureCoord = 0;
+  h->textureCoord = 0;
 #endif
+}
 
-      hitResults[*hitResultsLen] = h;
+/**
+  State of a resumable DDA cast of a single ray, the hits are taken from it one
+  by one with _RCL_nextRayHit, front to back. This allows to stop casting as
+  soon as the caller has seen enough hits.
+*/
+typedef struct
+{
+  RCL_Ray ray;
+  RCL_ArrayFunction arrayFunc;
+  RCL_ArrayFunction typeFunc;
+  int8_t useGrid;            // read the square grid instead of the functions
+  RCL_RayConstraints constraints;
 
-      *hitResultsLen += 1;
+  // DDA variables
+  RCL_Vector2D currentSquare;
+  RCL_Vector2D nextSideDist; // dist. from start to the next side in given axis
+  RCL_Vector2D delta;
+  RCL_Vector2D step;         // -1 or 1 for each axis
+  int8_t stepHorizontal;     // whether the last step was hor. or vert.
+  RCL_Unit rayDirXRecip, rayDirYRecip;
+  RCL_Unit squareType;
 
-      squareType = currentType;
+  uint16_t steps;            // DDA steps done so far
+  uint16_t hits;             // hits returned so far
+  uint16_t hitSteps;         // DDA steps done when the last hit was found
+} _RCL_RayIterator;
 
-      if (*hitResultsLen >= constraints.maxHits)
-        break;
-    }
+#define _RCL_ARRAY_VALUE(it,x,y) ((it)->useGrid ?\
+  _RCL_gridFloorCeilValue(_RCL_gridSquareAt(x,y)) : (it)->arrayFunc(x,y))
+
+/**
+  Starts a resumable cast of given ray, see _RCL_RayIterator. If useGrid is
+  non-zero, the squares are read from the square grid (as combined floor and
+  ceiling heights) instead of calling the array and type functions.
+*/
+static inline void _RCL_initRayIterator(_RCL_RayIterator *it, RCL_Ray ray,
+  RCL_ArrayFunction arrayFunc, RCL_ArrayFunction typeFunc, int8_t useGrid,
+  RCL_RayConstraints constraints)
+{
+  it->ray = ray;
+  it->arrayFunc = arrayFunc;
+  it->typeFunc = typeFunc;
+  it->useGrid = useGrid;
+  it->constraints = constraints;
+  it->stepHorizontal = 0;
+  it->steps = 0;
+  it->hits = 0;
+  it->hitSteps = 0;
+
+  _RCL_initDDA(ray,&(it->currentSquare),&(it->nextSideDist),&(it->delta),
+    &(it->step),&(it->rayDirXRecip),&(it->rayDirYRecip));
+
+  it->squareType =
+    _RCL_ARRAY_VALUE(it,it->currentSquare.x,it->currentSquare.y);
+}
+
+#if RCL_SKIP_UNIFORM_BLOCKS
+/**
+  Moves the DDA of a ray iterator out of the uniform grid block of 2^blockLevel
+  squares it is in, into the same square and state that the single DDA steps
+  would lead to.
+*/
+static inline void _RCL_skipGridBlock(_RCL_RayIterator *it, uint8_t blockLevel)
+{
+  RCL_Unit mask = (1 << blockLevel) - 1;
+
+  // number of steps in each axis that gets the ray out of the block:
+  RCL_Unit stepsX = it->step.x > 0 ?
+    mask + 1 - (it->currentSquare.x & mask) : (it->currentSquare.x & mask) + 1;
+  RCL_Unit stepsY = it->step.y > 0 ?
+    mask + 1 - (it->currentSquare.y & mask) : (it->currentSquare.y & mask) + 1;
+
+  // side distances at which the block would be left in each axis:
+  RCL_Unit exitX = it->nextSideDist.x + (stepsX - 1) * it->delta.x;
+  RCL_Unit exitY = it->nextSideDist.y + (stepsY - 1) * it->delta.y;
+
+  /* Now count the steps in the other axis that happen before leaving, the DDA
+     steps horizontally only if the x side is strictly closer. */
+
+  if (exitX < exitY)
+  {
+    stepsY = exitX >= it->nextSideDist.y ?
+      (exitX - it->nextSideDist.y) / it->delta.y + 1 : 0;
+
+    it->stepHorizontal = 1;
+  }
+  else
+  {
+    stepsX = exitY > it->nextSideDist.x ?
+      (exitY - it->nextSideDist.x - 1) / it->delta.x + 1 : 0;
+
+    it->stepHorizontal = 0;
+  }
+
+  it->nextSideDist.x += stepsX * it->delta.x;
+  it->nextSideDist.y += stepsY * it->delta.y;
+  it->currentSquare.x += stepsX * it->step.x;
+  it->currentSquare.y += stepsY * it->step.y;
+}
+#endif
+
+/**
+  Continues the DDA of a ray iterator until the next hit, which is written to
+  hit. Returns 1 if a hit was found or 0 if the ray constraints have been
+  reached (then nothing is written).
+*/
+static inline int8_t _RCL_nextRayHit(_RCL_RayIterator *it, RCL_HitResult *hit)
+{
+  if (it->hits >= it->constraints.maxHits)
+    return 0;
+
+  while (it->steps < it->constraints.maxSteps)
+  {
+    RCL_Vector2D square = it->currentSquare;
+    int8_t stepHorizontal = it->stepHorizontal;
+
+    RCL_Unit currentType = _RCL_ARRAY_VALUE(it,square.x,square.y);
 
     // DDA step
 
-    if (nextSideDist.x < nextSideDist.y)
+#if RCL_SKIP_UNIFORM_BLOCKS
+    uint8_t blockLevel = (it->useGrid && currentType == it->squareType) ?
+      _RCL_gridSquareAt(square.x,square.y)->blockLevel : 0;
+
+    if (blockLevel != 0)
+      _RCL_skipGridBlock(it,blockLevel); // counts as a single step
+    else
+#endif
+    if (it->nextSideDist.x < it->nextSideDist.y)
     {
-      nextSideDist.x += delta.x;
-      currentSquare.x += step.x;
-      stepHorizontal = 1;
+      it->nextSideDist.x += it->delta.x;
+      it->currentSquare.x += it->step.x;
+      it->stepHorizontal = 1;
     }
     else
     {
-      nextSideDist.y += delta.y;
-      currentSquare.y += step.y;
-      stepHorizontal = 0;
+      it->nextSideDist.y += it->delta.y;
+      it->currentSquare.y += it->step.y;
+      it->stepHorizontal = 0;
+    }
+
+    it->steps++;
+
+    if (RCL_unlikely(currentType != it->squareType))
+    {
+      // collision
+
+      _RCL_makeHit(hit,it->ray,square,stepHorizontal,it->step,
+        it->rayDirXRecip,it->rayDirYRecip,currentType);
+
+      if (it->typeFunc != 0)
+        hit->type = it->useGrid ?
+          _RCL_gridSquareAt(square.x,square.y)->type :
+          it->typeFunc(square.x,square.y);
+
+      it->squareType = currentType;
+      it->hits++;
+      it->hitSteps = it->steps;
+
+      return 1;
     }
   }
+
+  return 0;
+}
+
+#undef _RCL_ARRAY_VALUE
+
+/**
+  Implements RCL_castRayMultiHit, useGrid says whether to use the square grid
+  (see _RCL_initRayIterator).
+*/
+static inline void _RCL_castRayMultiHit(RCL_Ray ray,
+  RCL_ArrayFunction arrayFunc, RCL_ArrayFunction typeFunc, int8_t useGrid,
+  RCL_HitResult *hitResults, uint16_t *hitResultsLen,
+  RCL_RayConstraints constraints)
+{
+  _RCL_RayIterator it;
+
+  _RCL_initRayIterator(&it,ray,arrayFunc,typeFunc,useGrid,constraints);
+
+  *hitResultsLen = 0;
+
+  while (_RCL_nextRayHit(&it,hitResults + *hitResultsLen))
+    *hitResultsLen += 1;
+}
+
+void RCL_castRayMultiHit(RCL_Ray ray, RCL_ArrayFunction arrayFunc,
+  RCL_ArrayFunction typeFunc, RCL_HitResult *hitResults,
+  uint16_t *hitResultsLen, RCL_RayConstraints constraints)
+{
+  _RCL_castRayMultiHit(ray,arrayFunc,typeFunc,0,hitResults,hitResultsLen,
+    constraints);
 }
 
 RCL_HitResult RCL_castRay(RCL_Ray ray, RCL_ArrayFunction arrayFunc)
@@ -962,7 +1339,19 @@ void RCL_castRaysMultiHit(RCL_Camera cam, RCL_ArrayFunction arrayFunc,
   RCL_ArrayFunction typeFunction, RCL_ColumnFunction columnFunc,
   RCL_RayConstraints constraints)
 {
-  RCL_Vector2D dir1 =
+  RCL_castRaysMultiHitColumns(cam,arrayFunc,typeFunction,columnFunc,
+    constraints,0,cam.resolution.x);
+}
+
+/**
+  Computes what's needed for casting the rays of screen columns: the ray
+  direction of the leftmost column (dir1) and the difference between the
+  directions of the rightmost and leftmost columns (dX, dY).
+*/
+static inline void _RCL_columnRaysSetup(RCL_Camera cam, RCL_Vector2D *dir1,
+  RCL_Unit *dX, RCL_Unit *dY)
+{
+  *dir1 =
     RCL_angleToDirection(cam.direction - RCL_HORIZONTAL_FOV_HALF);
 
   RCL_Vector2D dir2 =
@@ -973,14 +1362,24 @@ void RCL_castRaysMultiHit(RCL_Camera cam, RCL_ArrayFunction arrayFunc,
 
   RCL_Unit cos = RCL_nonZero(RCL_cos(RCL_HORIZONTAL_FOV_HALF));
 
-  dir1.x = (dir1.x * RCL_UNITS_PER_SQUARE) / cos;
-  dir1.y = (dir1.y * RCL_UNITS_PER_SQUARE) / cos;
+  dir1->x = (dir1->x * RCL_UNITS_PER_SQUARE) / cos;
+  dir1->y = (dir1->y * RCL_UNITS_PER_SQUARE) / cos;
 
   dir2.x = (dir2.x * RCL_UNITS_PER_SQUARE) / cos;
   dir2.y = (dir2.y * RCL_UNITS_PER_SQUARE) / cos;
 
-  RCL_Unit dX = dir2.x - dir1.x;
-  RCL_Unit dY = dir2.y - dir1.y;
+  *dX = dir2.x - dir1->x;
+  *dY = dir2.y - dir1->y;
+}
+
+void RCL_castRaysMultiHitColumns(RCL_Camera cam, RCL_ArrayFunction arrayFunc,
+  RCL_ArrayFunction typeFunction, RCL_ColumnFunction columnFunc,
+  RCL_RayConstraints constraints, int16_t fromColumn, int16_t toColumn)
+{
+  RCL_Vector2D dir1;
+  RCL_Unit dX, dY;
+
+  _RCL_columnRaysSetup(cam,&dir1,&dX,&dY);
 
   RCL_HitResult hits[constraints.maxHits];
   uint16_t hitCount;
@@ -988,10 +1387,10 @@ void RCL_castRaysMultiHit(RCL_Camera cam, RCL_ArrayFunction arrayFunc,
   RCL_Ray r;
   r.start = cam.position;
 
-  RCL_Unit currentDX = 0;
-  RCL_Unit currentDY = 0;
+  RCL_Unit currentDX = fromColumn * dX;
+  RCL_Unit currentDY = fromColumn * dY;
 
-  for (int16_t i = 0; i < cam.resolution.x; ++i)
+  for (int16_t i = fromColumn; i < toColumn; ++i)
   {
     /* Here by linearly interpolating the direction vector its length changes,
     which in result achieves correcting the fish eye effect (computing
@@ -1000,7 +1399,8 @@ void RCL_castRaysMultiHit(RCL_Camera cam, RCL_ArrayFunction arrayFunc,
     r.direction.x = dir1.x + currentDX / cam.resolution.x;
     r.direction.y = dir1.y + currentDY / cam.resolution.x;
 
-    RCL_castRayMultiHit(r,arrayFunc,typeFunction,hits,&hitCount,constraints);
+    _RCL_castRayMultiHit(r,arrayFunc,typeFunction,0,hits,&hitCount,
+      constraints);
 
     columnFunc(hits,hitCount,i,r);
 
@@ -1083,6 +1483,50 @@ static inline int16_t _RCL_drawHorizontalColumn(
 
   _RCL_UNUSED(depth);
 
+#ifdef RCL_SPAN_FUNCTION
+  if (!computeCoords)
+  {
+    RCL_SpanInfo span;
+
+    span.length = (limit - yCurrent) * increment;
+
+    if (span.length > 0)
+    {
+      span.increment = increment;
+      span.texCoordScaled = 0;
+      span.texCoordStepScaled = 0;
+
+      if (computeDepth)
+      {
+        span.depthIncrement = depthIncrementMultiplier *
+          _RCL_horizontalDepthStep;
+        span.depth = pixelInfo->depth + RCL_abs(verticalOffset) *
+          RCL_VERTICAL_DEPTH_MULTIPLY + span.depthIncrement;
+        pixelInfo->depth = RCL_zeroClamp(span.depth);
+      }
+      else
+      {
+        span.depth = pixelInfo->depth;
+        span.depthIncrement = 0;
+      }
+
+      pixelInfo->position.y = yCurrent + increment;
+
+      RCL_SPAN_FUNCTION(pixelInfo,&span);
+
+      // leave the pixel info as if the pixels were drawn one by one:
+
+      pixelInfo->position.y = limit;
+
+      if (computeDepth)
+        pixelInfo->depth =
+          RCL_zeroClamp(span.depth + (span.length - 1) * span.depthIncrement);
+    }
+
+    return limit;
+  }
+#endif
+
   /* for performance reasons have different version of the critical loop
      to be able to branch early */
   #define loop(doDepth,doCoords)\
@@ -1200,6 +1644,41 @@ static inline int16_t _RCL_drawWall(
 
   RCL_Unit textureCoordScaled = pixelInfo->texCoords.y;
 
+#ifdef RCL_SPAN_FUNCTION
+  RCL_SpanInfo span;
+
+  span.length = (limit - yCurrent) * increment;
+
+  if (span.length > 0)
+  {
+    span.increment = increment;
+    span.depth = pixelInfo->depth;
+    span.depthIncrement = 0;
+    span.texCoordScaled = textureCoordScaled;
+    span.texCoordStepScaled = coordStepScaled;
+
+    pixelInfo->position.y = yCurrent + increment;
+
+#if RCL_COMPUTE_WALL_TEXCOORDS == 1
+    pixelInfo->texCoords.y =
+      textureCoordScaled / RCL_TEXTURE_INTERPOLATION_SCALE;
+#endif
+
+    RCL_SPAN_FUNCTION(pixelInfo,&span);
+
+    // leave the pixel info as if the pixels were drawn one by one:
+
+    pixelInfo->position.y = limit;
+
+#if RCL_COMPUTE_WALL_TEXCOORDS == 1
+    pixelInfo->texCoords.y = (textureCoordScaled + (span.length - 1) *
+      coordStepScaled) / RCL_TEXTURE_INTERPOLATION_SCALE;
+#endif
+  }
+
+  return limit;
+#endif
+
   for (RCL_Unit i = yCurrent + increment; 
        increment == -1 ? i >= limit : i <= limit; // TODO: is efficient?
        i += increment)
@@ -1235,8 +1714,14 @@ static inline void _RCL_makeInfiniteHit(RCL_HitResult *hit, RCL_Ray *ray)
   hit->type = 0;
 }
 
-void _RCL_columnFunctionComplex(RCL_HitResult *hits, uint16_t hitCount, uint16_t x,
-  RCL_Ray ray)
+/**
+  Draws one column of complex rendering. The hits are either given as an array
+  (hits, hitCount) or, if iterator is non-zero, pulled from the ray iterator one
+  by one, in which case casting stops as soon as the column is fully covered.
+  Returns the number of hits the column needed (until it was fully covered).
+*/
+static inline uint16_t _RCL_drawComplexColumn(RCL_HitResult *hits,
+  uint16_t hitCount, _RCL_RayIterator *iterator, uint16_t x, RCL_Ray ray)
 {
   // last written Y position, can never go backwards
   RCL_Unit fPosY = _RCL_camera.resolution.y;
@@ -1254,11 +1739,21 @@ void _RCL_columnFunctionComplex(RCL_HitResult *hits, uint16_t hitCount, uint16_t
   p.texCoords.y = 0;
 
   // we'll be simulatenously drawing the floor and the ceiling now  
-  for (RCL_Unit j = 0; j <= hitCount; ++j)
-  {                    // ^ = add extra iteration for horizon plane
-    int8_t drawingHorizon = j == hitCount;
-
+  for (RCL_Unit j = 0; ; ++j)
+  {
     RCL_HitResult hit;
+    int8_t drawingHorizon;
+
+    if (iterator == 0)
+    {
+      drawingHorizon = j == hitCount; // extra iteration for horizon plane
+
+      if (!drawingHorizon)
+        hit = hits[j];
+    }
+    else
+      drawingHorizon = !_RCL_nextRayHit(iterator,&hit);
+
     RCL_Unit distance = 1;
 
     RCL_Unit fWallHeight = 0, cWallHeight = 0;
@@ -1268,11 +1763,10 @@ void _RCL_columnFunctionComplex(RCL_HitResult *hits, uint16_t hitCount, uint16_t
 
     if (!drawingHorizon)
     {
-      hit = hits[j];
       distance = RCL_nonZero(hit.distance); 
       p.hit = hit;
 
-      fWallHeight = _RCL_floorFunction(hit.square.x,hit.square.y);
+      fWallHeight = _RCL_floorHeightAt(hit.square.x,hit.square.y);
       fZ2World = fWallHeight - _RCL_camera.height;
       fZ1Screen = _RCL_middleRow - RCL_perspectiveScaleVertical(
         (fZ1World * _RCL_camera.resolution.y) /
@@ -1283,7 +1777,7 @@ void _RCL_columnFunctionComplex(RCL_HitResult *hits, uint16_t hitCount, uint16_t
 
       if (_RCL_ceilFunction != 0)
       {
-        cWallHeight = _RCL_ceilFunction(hit.square.x,hit.square.y);
+        cWallHeight = _RCL_ceilHeightAt(hit.square.x,hit.square.y);
         cZ2World = cWallHeight - _RCL_camera.height;
         cZ1Screen = _RCL_middleRow - RCL_perspectiveScaleVertical(
           (cZ1World * _RCL_camera.resolution.y) /
@@ -1400,9 +1894,34 @@ void _RCL_columnFunctionComplex(RCL_HitResult *hits, uint16_t hitCount, uint16_t
         cZ1World = cZ2World; // for the next iteration
       }              // ^ puposfully allow outside screen bounds here 
     }
+
+    if (_RCL_columnInfo != 0 && j == 0)
+    {
+      _RCL_columnInfo[x].firstHitDepth =
+        drawingHorizon ? RCL_INFINITY : distance;
+      _RCL_columnInfo[x].coverDepth = RCL_INFINITY;
+    }
+
+    if (drawingHorizon)
+      return j;
+
+    if (fPosY <= cPosY + 1)
+    {
+      if (_RCL_columnInfo != 0)
+        _RCL_columnInfo[x].coverDepth = distance;
+
+      return j + 1; /* Column fully covered, nothing further can be drawn (not
+                       even the horizon), so don't cast any further. */
+    }
   }
 }
 
+void _RCL_columnFunctionComplex(RCL_HitResult *hits, uint16_t hitCount, uint16_t x,
+  RCL_Ray ray)
+{
+  _RCL_drawComplexColumn(hits,hitCount,0,x,ray);
+}
+
 void _RCL_columnFunctionSimple(RCL_HitResult *hits, uint16_t hitCount,
   uint16_t x, RCL_Ray ray)
 {
@@ -1565,9 +2084,8 @@ static inline void _RCL_precomputeFloorDistances(RCL_Camera camera,
              RCL_abs(i - _RCL_middleRow));
 }
 
-void RCL_renderComplex(RCL_Camera cam, RCL_ArrayFunction floorHeightFunc,
-  RCL_ArrayFunction ceilingHeightFunc, RCL_ArrayFunction typeFunction,
-  RCL_RayConstraints constraints)
+void RCL_renderComplexBegin(RCL_Camera cam, RCL_ArrayFunction floorHeightFunc,
+  RCL_ArrayFunction ceilingHeightFunc)
 {
   _RCL_floorFunction = floorHeightFunc;
   _RCL_ceilFunction = ceilingHeightFunc;
@@ -1581,27 +2099,130 @@ void RCL_renderComplex(RCL_Camera cam, RCL_ArrayFunction floorHeightFunc,
   _RCL_fHorizontalDepthStart = _RCL_middleRow + halfResY;
   _RCL_cHorizontalDepthStart = _RCL_middleRow - halfResY;
 
-  _RCL_startFloorHeight = floorHeightFunc(
+  _RCL_startFloorHeight = _RCL_floorHeightAt(
     RCL_divRoundDown(cam.position.x,RCL_UNITS_PER_SQUARE),
     RCL_divRoundDown(cam.position.y,RCL_UNITS_PER_SQUARE)) -1 * cam.height;
 
   _RCL_startCeil_Height = 
     ceilingHeightFunc != 0 ?
-      ceilingHeightFunc(
+      _RCL_ceilHeightAt(
         RCL_divRoundDown(cam.position.x,RCL_UNITS_PER_SQUARE),
         RCL_divRoundDown(cam.position.y,RCL_UNITS_PER_SQUARE)) -1 * cam.height
       : RCL_INFINITY;
 
   _RCL_horizontalDepthStep = RCL_HORIZON_DEPTH / cam.resolution.y; 
 
+  /* The FOV correction factors are computed lazily on first use, we force it
+     here so that it doesn't happen while the columns may be rendered
+     concurrently. */
+
+  RCL_perspectiveScaleVertical(0,1);
+  RCL_perspectiveScaleHorizontal(0,1);
+}
+
+/**
+  Casts the rays of given columns for complex rendering, pulling the hits of
+  each ray lazily (see RCL_STREAM_HITS) or casting all of them at once,
+  depending on the settings.
+*/
+static inline void _RCL_renderComplexColumns(RCL_ArrayFunction typeFunction,
+  RCL_RayConstraints constraints, int16_t fromColumn, int16_t toColumn)
+{
+  RCL_Vector2D dir1;
+  RCL_Unit dX, dY;
+
+  _RCL_columnRaysSetup(_RCL_camera,&dir1,&dX,&dY);
+
+  RCL_Ray r;
+  r.start = _RCL_camera.position;
+
+  // skip to the first column to render (see RCL_setColumnStep)
+  fromColumn += (_RCL_columnStep + _RCL_columnOffset -
+    fromColumn % _RCL_columnStep) % _RCL_columnStep;
+
+  RCL_Unit currentDX = fromColumn * dX;
+  RCL_Unit currentDY = fromColumn * dY;
+
+  dX *= _RCL_columnStep;
+  dY *= _RCL_columnStep;
+
+#if !RCL_STREAM_HITS
+  RCL_HitResult hits[constraints.maxHits];
+  uint16_t hitSteps[constraints.maxHits]; // steps done when each hit was found
+#endif
+
+  _RCL_RayIterator it;
+
+  for (int16_t i = fromColumn; i < toColumn; i += _RCL_columnStep)
+  {
+    r.direction.x = dir1.x + currentDX / _RCL_camera.resolution.x;
+    r.direction.y = dir1.y + currentDY / _RCL_camera.resolution.x;
+
+    RCL_ColumnInfo *info = _RCL_columnInfo != 0 ? _RCL_columnInfo + i : 0;
+    RCL_RayConstraints c = constraints;
+
+    if (info != 0)
+    {
+      c.maxHits = RCL_min(c.maxHits,info->maxHits);
+      c.maxSteps = RCL_min(c.maxSteps,info->maxSteps);
+    }
+
+    _RCL_initRayIterator(&it,r,_RCL_floorCeilFunction,typeFunction,
+      _RCL_grid != 0,c);
+
+    uint16_t usedHits, usedSteps;
+
+#if RCL_STREAM_HITS
+    usedHits = _RCL_drawComplexColumn(0,0,&it,i,r);
+    usedSteps = it.hitSteps;
+#else
+    uint16_t hitCount = 0;
+
+    while (_RCL_nextRayHit(&it,hits + hitCount))
+    {
+      hitSteps[hitCount] = it.steps;
+      hitCount++;
+    }
+
+    usedHits = _RCL_drawComplexColumn(hits,hitCount,0,i,r);
+    usedSteps = usedHits != 0 ? hitSteps[usedHits - 1] : 0;
+#endif
+
+    if (info != 0)
+    {
+      /* A column that didn't get fully covered needed all the steps its ray
+         did, anything found further could have been seen in it. */
+      if (info->coverDepth == RCL_INFINITY)
+        usedSteps = it.steps;
+
+      info->usedHits = usedHits;
+      info->usedSteps = usedSteps;
+    }
+
+    currentDX += dX;
+    currentDY += dY;
+  }
+}
+
+void RCL_renderComplexColumns(RCL_ArrayFunction typeFunction,
+  RCL_RayConstraints constraints, int16_t fromColumn, int16_t toColumn)
+{
+  _RCL_renderComplexColumns(typeFunction,constraints,fromColumn,toColumn);
+}
+
+void RCL_renderComplex(RCL_Camera cam, RCL_ArrayFunction floorHeightFunc,
+  RCL_ArrayFunction ceilingHeightFunc, RCL_ArrayFunction typeFunction,
+  RCL_RayConstraints constraints)
+{
+  RCL_renderComplexBegin(cam,floorHeightFunc,ceilingHeightFunc);
+
 #if RCL_COMPUTE_FLOOR_TEXCOORDS == 1
   RCL_Unit floorPixelDistances[cam.resolution.y];
   _RCL_precomputeFloorDistances(cam,floorPixelDistances,0);
   _RCL_floorPixelDistances = floorPixelDistances; // pass to column function
 #endif
 
-  RCL_castRaysMultiHit(cam,_RCL_floorCeilFunction,typeFunction,
-    _RCL_columnFunctionComplex,constraints);
+  _RCL_renderComplexColumns(typeFunction,constraints,0,cam.resolution.x);
 }
 
 void RCL_renderSimple(RCL_Camera cam, RCL_ArrayFunction floorHeightFunc,
@@ -1697,6 +2318,43 @@ RCL_PixelInfo RCL_mapToScreen(RCL_Vector2D worldPosition, RCL_Unit height,
   return result;
 }
 
+void RCL_mapToScreenMany(const RCL_Unit *positionsX,
+  const RCL_Unit *positionsY, const RCL_Unit *heights, uint16_t count,
+  RCL_Camera camera, RCL_Unit *depths, RCL_Unit *screenX, RCL_Unit *screenY)
+{
+  RCL_Unit middleColumn = camera.resolution.x / 2;
+
+  RCL_Unit cos = RCL_cos(camera.direction);
+  RCL_Unit sin = RCL_sin(camera.direction);
+
+  // rotate to camera space, screenX temporarily holds the sideways offset
+
+  for (uint16_t i = 0; i < count; ++i)
+  {
+    RCL_Unit x = positionsX[i] - camera.position.x;
+    RCL_Unit y = positionsY[i] - camera.position.y;
+
+    depths[i] = (x * cos - y * sin) / RCL_UNITS_PER_SQUARE;
+    screenX[i] = (x * sin + y * cos) / RCL_UNITS_PER_SQUARE;
+  }
+
+  for (uint16_t i = 0; i < count; ++i)
+  {
+    RCL_Unit depth = depths[i];
+
+    if (depth <= 0)
+      continue;
+
+    screenX[i] = middleColumn -
+      (RCL_perspectiveScaleHorizontal(screenX[i],depth) * middleColumn) /
+      RCL_UNITS_PER_SQUARE;
+
+    screenY[i] = camera.resolution.y / 2 -
+      (RCL_perspectiveScaleVertical(heights[i] - camera.height,depth) *
+      camera.resolution.y) / RCL_UNITS_PER_SQUARE + camera.shear;
+  }
+}
+
 RCL_Unit RCL_degreesToUnitsAngle(int16_t degrees)
 {
   return (degrees * RCL_UNITS_PER_SQUARE) / 360;
@@ -133,6 +133,139 @@
   #define SFG_RESOLUTION_SCALEDOWN 1
 #endif
 
+/**
+  Says whether the game draws directly into a frontend provided buffer (set
+  with SFG_setFramebuffer) instead of calling SFG_setPixel for each pixel, and
+  in what pixel format: 0 means no buffer (SFG_setPixel is used), 1 means 8 bit
+  palette indices, 2 means RGB565 (16 bit) and 3 means XRGB8888 (32 bit, red in
+  bits 16 to 23). This saves a function call per screen pixel and the frontend
+  can present the buffer as is.
+*/
+#ifndef SFG_FRAMEBUFFER
+  #define SFG_FRAMEBUFFER 0
+#endif
+
+/**
+  With SFG_RESOLUTION_SCALEDOWN greater than 1 this says how the game picture
+  is scaled up to the screen: 0 means each game pixel is drawn as a block of
+  screen pixels right away, 1 means the picture is drawn into a game resolution
+  buffer first and scaled up (nearest neighbour) to the screen row by row after
+  each frame (in parallel with SFG_RENDER_THREADS), 2 is the same but uses the
+  Scale2x/Scale3x pixel art filter for scaledown 2/3 (nearest neighbour for
+  other values), which smooths diagonal edges. 1 and 2 need an extra buffer of
+  the game resolution size.
+*/
+#ifndef SFG_UPSCALE
+  #define SFG_UPSCALE 0
+#endif
+
+/**
+  Enables the post-processing pipeline: effects such as CRT scanlines, motion
+  blur or grayscale that are applied to the finished game picture after each
+  frame and can be turned on/off at runtime with SFG_setPostProcess (see
+  SFG_POST_PROCESS_* pass flags). This needs the game resolution buffer of
+  SFG_UPSCALE (which is turned on if it isn't) plus another one for motion
+  blur.
+*/
+#ifndef SFG_POST_PROCESS
+  #define SFG_POST_PROCESS 0
+#endif
+
+/**
+  Post-processing passes (SFG_POST_PROCESS_* flags) that are on when the game
+  starts, only with SFG_POST_PROCESS.
+*/
+#ifndef SFG_POST_PROCESS_PASSES
+  #define SFG_POST_PROCESS_PASSES 0
+#endif
+
+/**
+  Length of the dithered motion blur post-processing effect in frames, each
+  pixel is updated once in this many frames. Should be kept a power of two.
+*/
+#ifndef SFG_MOTION_BLUR_FRAMES
+  #define SFG_MOTION_BLUR_FRAMES 4
+#endif
+
+/**
+  If on, font characters are converted to rows of pixels at init and the HUD
+  bar picture is cached and only drawn again when something it shows (health,
+  ammo, cards, ...) changes, otherwise it's just copied to the screen. This
+  costs a buffer of the HUD bar size and helps at high resolutions.
+*/
+#ifndef SFG_CACHED_HUD
+  #define SFG_CACHED_HUD 0
+#endif
+
+/**
+  If on, colors of the map squares shown on the level map are computed only
+  once per level, when a part of the map gets revealed, instead of each frame
+  the map is shown. This costs SFG_MAP_SIZE * SFG_MAP_SIZE bytes.
+*/
+#ifndef SFG_CACHED_MAP
+  #define SFG_CACHED_MAP 0
+#endif
+
+/**
+  If on, sprites (monsters, items and projectiles) are first collected into one
+  list sorted by distance and then drawn front to back, remembering for each
+  screen column a mask of rows already covered by nearer sprites so that
+  hidden sprite pixels are skipped without sampling the texture. This also
+  makes nearer sprites always cover farther ones, independently of the order
+  of records. Costs a sprite list and one bit per pixel of the 3D view.
+*/
+#ifndef SFG_SORTED_SPRITES
+  #define SFG_SORTED_SPRITES 0
+#endif
+
+/**
+  If on, monster, item and effect sprites are converted at init to columns of
+  runs of opaque texels, so that drawing a sprite only walks its visible pixels
+  and the transparent ones are skipped without being sampled. The buffer is
+  sized for the worst case and takes about 60 kB of RAM.
+*/
+#ifndef SFG_RLE_SPRITES
+  #define SFG_RLE_SPRITES 0
+#endif
+
+/**
+  If on, positions of all sprites (monsters, items and projectiles) are first
+  gathered into arrays and projected to the screen together, and sprites that
+  are behind the camera or completely outside the screen are thrown away
+  before their visibility is checked (which casts a ray). This helps levels
+  with many elements and costs about 7 kB of RAM.
+*/
+#ifndef SFG_BATCHED_SPRITES
+  #define SFG_BATCHED_SPRITES 0
+#endif
+
+/**
+  If on, the rendering of the 3D view records for each screen column the depth
+  of its first hit and the depth at which it got fully covered, and sprite
+  visibility is decided from these where possible: a sprite is hidden if all
+  columns it spans are covered in front of it, visible if nothing is hit in
+  front of it around its center, and only otherwise a 3D ray is cast. This
+  saves many rays in busy scenes and also stops sprites fully behind walls from
+  showing through them.
+*/
+#ifndef SFG_VIEW_SPRITE_VISIBILITY
+  #define SFG_VIEW_SPRITE_VISIBILITY 0
+#endif
+
+/**
+  If on, the rendering of the 3D view writes the depth of each wall pixel to a
+  full z-buffer and sprites are only drawn where they're in front of the walls,
+  so they no longer show through walls or disappear behind corners as a whole
+  (the visibility ray is still cast for each sprite though). Coarse tiles of
+  the z-buffer keep the minimum and maximum depth, so that most sprite pixels
+  are accepted or rejected a whole tile at once and only tiles crossed by wall
+  edges are compared pixel by pixel. Floor and ceiling don't write the depth.
+  This costs one byte per pixel of the 3D view.
+*/
+#ifndef SFG_FULL_Z_BUFFER
+  #define SFG_FULL_Z_BUFFER 0
+#endif
+
 /**
   Multiplier, in RCL_Units (1024 == 1.0), of the damager player takes. This can
   be used to balance difficulty.
@@ -457,6 +590,190 @@
   #define SFG_FORCE_SINGLE_ITEM_MENU 0
 #endif
 
+/**
+  Number of threads the 3D view is rendered with: the screen is split into this
+  many vertical strips of columns which are rendered in parallel. 1 means no
+  threads are used. Values above 1 need POSIX threads (link with -pthread) and
+  are meant for multicore platforms such as PC. The result is the same as with
+  one thread.
+*/
+#ifndef SFG_RENDER_THREADS
+  #define SFG_RENDER_THREADS 1
+#endif
+
+/**
+  If on, the floor heights, ceiling heights and textures of all map squares are
+  precomputed into a grid (updated each frame for moving squares) that the ray
+  casting reads directly instead of calling back into the game for every ray
+  step. This is considerably faster but needs some extra RAM (about 24 kB).
+*/
+#ifndef SFG_SQUARE_GRID
+  #define SFG_SQUARE_GRID 0
+#endif
+
+/**
+  If on, the 3D view is drawn by vertical spans of pixels rather than pixel by
+  pixel, which saves a lot of per pixel overhead as many things are constant
+  along a span. The result is the same.
+*/
+#ifndef SFG_SPAN_RENDERING
+  #define SFG_SPAN_RENDERING 0
+#endif
+
+/**
+  Enables quality presets of the 3D view that can be switched at runtime with
+  SFG_setQuality: the span drawing functions are compiled in a variant for
+  each preset and the one for the current preset is called through a function
+  table, so lowering the quality doesn't need a rebuild nor adds checks to the
+  pixel loops. The settings (SFG_TEXTURE_DISTANCE, SFG_DITHERED_SHADOW,
+  SFG_DRAW_LEVEL_BACKGROUND etc.) give the high quality preset. The medium one
+  turns off dithered shadow and only textures walls up to
+  SFG_QUALITY_MEDIUM_TEXTURE_DISTANCE, the low one turns off textures and
+  background completely. Measured on PC, the medium preset is about 5 % and
+  the low one about 20 % faster than the high one.
+
+  This always turns on SFG_SPAN_RENDERING, even if it's set to 0, as calling
+  through the table for every pixel would be too slow.
+*/
+#ifndef SFG_QUALITY_PRESETS
+  #define SFG_QUALITY_PRESETS 0
+#endif
+
+/**
+  Quality preset the game starts with, only with SFG_QUALITY_PRESETS: 0 (low),
+  1 (medium) or 2 (high).
+*/
+#ifndef SFG_DEFAULT_QUALITY
+  #define SFG_DEFAULT_QUALITY 2
+#endif
+
+/**
+  If on, the rays of the 3D view are cast lazily, hit by hit, and a column stops
+  casting once its floor and ceiling meet. The result is the same, but closed
+  indoor areas become cheaper and SFG_RAYCASTING_MAX_HITS can be raised for
+  longer views at a much lower cost.
+*/
+#ifndef SFG_STREAM_HITS
+  #define SFG_STREAM_HITS 0
+#endif
+
+/**
+  If on, uniform areas of the map (same floor and ceiling heights) are found
+  when a level starts and rays cross them in a single step. A step then reaches
+  much farther, so this gives a longer view distance for the same
+  SFG_RAYCASTING_MAX_STEPS, or the same view for fewer steps, mainly in big open
+  levels. This only has effect with SFG_SQUARE_GRID.
+*/
+#ifndef SFG_SKIP_UNIFORM_BLOCKS
+  #define SFG_SKIP_UNIFORM_BLOCKS 0
+#endif
+
+/**
+  If on, each screen column gets its own ray constraints every frame: the
+  steps and hits its ray needed in the previous frame plus a small margin, and
+  columns get the full constraints periodically, after using up their budget
+  and, at the view edges, when the camera turns. This saves a lot of ray
+  casting, but something newly appearing farther than what a column needed
+  before (e.g. behind an opening door) may show up a few frames late.
+*/
+#ifndef SFG_ADAPTIVE_RAY_BUDGETS
+  #define SFG_ADAPTIVE_RAY_BUDGETS 0
+#endif
+
+/**
+  If on, a copy of the rendered 3D view is kept and drawn again instead of
+  rendering a new one as long as the camera stays the same and nothing in
+  range moves (doors, elevators, squeezers), e.g. while the player is standing
+  still. Only sprites, weapon and HUD are then drawn over it. This saves a lot
+  of work (and power) but needs an extra buffer of the game resolution size.
+*/
+#ifndef SFG_REUSE_STATIC_FRAMES
+  #define SFG_REUSE_STATIC_FRAMES 0
+#endif
+
+/**
+  If on, the resolution of the 3D view is adjusted at runtime to keep the
+  target FPS: it's lowered when the frames take too long to compute and raised
+  back when there's time to spare. This allows one binary to run well on very
+  different CPUs. The resolution can be lowered up to
+  SFG_DYNAMIC_RESOLUTION_MAX_X times horizontally (on top of
+  SFG_RAYCASTING_SUBSAMPLE) and SFG_DYNAMIC_RESOLUTION_MAX_Y times vertically.
+*/
+#ifndef SFG_DYNAMIC_RESOLUTION
+  #define SFG_DYNAMIC_RESOLUTION 0
+#endif
+
+#ifndef SFG_DYNAMIC_RESOLUTION_MAX_X
+  #define SFG_DYNAMIC_RESOLUTION_MAX_X 4
+#endif
+
+#ifndef SFG_DYNAMIC_RESOLUTION_MAX_Y
+  #define SFG_DYNAMIC_RESOLUTION_MAX_Y 2
+#endif
+
+/**
+  If on, only every other column of the 3D view is ray cast each frame,
+  alternating the even and odd columns, and the other columns are kept from the
+  previous frame. This almost halves the rendering time at full horizontal
+  resolution, but moving things may look "combed". The whole view is rendered
+  when the camera turns or moves fast (see SFG_INTERLACED_MAX_TURN_SPEED). Needs
+  an extra buffer of the game resolution size (shared with
+  SFG_REUSE_STATIC_FRAMES).
+*/
+#ifndef SFG_INTERLACED_RENDERING
+  #define SFG_INTERLACED_RENDERING 0
+#endif
+
+/**
+  If on, a table of the final 3D view color for each shadow (fog) value and
+  palette color, with SFG_BRIGHTNESS already applied, is computed at init, so
+  that shading a pixel is just one table lookup. Needs SFG_SHADE_LEVELS * 256
+  bytes of RAM.
+*/
+#ifndef SFG_SHADE_TABLES
+  #define SFG_SHADE_TABLES 0
+#endif
+
+/**
+  If on, the textures of the current level (walls, door, background) and all
+  3D sprites are decoded to one byte per texel, so drawing them doesn't have to
+  unpack the 4 bit texels and look up their colors. This needs about 46 kB of
+  RAM, so it's only good for platforms with a lot of it (e.g. PC).
+*/
+#ifndef SFG_DECODED_TEXTURES
+  #define SFG_DECODED_TEXTURES 0
+#endif
+
+/**
+  If on, smaller versions of wall textures (MIP maps of 16x16, 8x8, ..., 1x1
+  texels) are computed at init and walls use the one that best fits their size
+  on screen. This reduces aliasing of distant walls, which also makes them a
+  bit faster to draw. SFG_TEXTURE_DISTANCE is then only used to turn texturing
+  off (value 0), the MIP maps replace the switch to the average color.
+*/
+#ifndef SFG_MIPMAPS
+  #define SFG_MIPMAPS 0
+#endif
+
+/**
+  Scales (in %) the distances at which walls switch to smaller MIP maps (see
+  SFG_MIPMAPS). Lower values make distant walls more blurry but faster to draw,
+  higher values make them sharper but more aliased.
+*/
+#ifndef SFG_MIPMAP_DISTANCE_PERCENT
+  #define SFG_MIPMAP_DISTANCE_PERCENT 100
+#endif
+
+/**
+  If on, the level background is decoded at level start and the background
+  column of each screen column is looked up once per frame, so drawing a
+  background pixel is just two table reads. This helps mostly outdoor levels
+  where a lot of pixels are the sky. Not used with SFG_BACKGROUND_BLUR.
+*/
+#ifndef SFG_PRESCALED_BACKGROUND
+  #define SFG_PRESCALED_BACKGROUND 0
+#endif
+
 //------ developer/debug settings ------
 
 /**